@@ -43,6 +43,14 @@
 #include "ns3/applications-module.h"
 #include "ns3/network-module.h"
 
+#include "flow-stats-collector.h"
+#include "fork-sweep.h"
+#include "pre-associated-wifi-helper.h"
+#include "profiling-scheduler.h"
+#include "scenario-bench.h"
+#include "station-echo-sweep.h"
+#include "udp-echo-rtt-client.h"
+
 using namespace ns3;
 NS_LOG_COMPONENT_DEFINE ("Wifi-2-nodes-fixed");
 void
@@ -71,29 +79,64 @@ PrintAddresses(Ipv4InterfaceContainer container, std::string header)
     std::cout << std::endl;
 }
 
-int
-main (int argc, char *argv[])
+// Number of echo replies that made it back to the STA in the current run
+static uint32_t g_repliesReceived = 0;
+
+// Address of the AP, used to pick the echo replies out of everything
+// else delivered to the STA
+static Ipv4Address g_apAddress;
+
+// The STA that runs the echo client
+static Ptr<Node> g_staNode;
+
+// Whether the STA is associated at start-up, with the AP silent afterwards
+static bool g_preAssociated = false;
+
+// Whether the Wi-Fi devices write pcap files
+static bool g_tracing = false;
+
+// File the flow statistics of a single run are written to, if any
+static std::string g_flowStats;
+
+// Whether the echo client measures round trips instead of logging packets
+static bool g_rtt = false;
+
+void
+EchoReplyDelivered (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+    if (header.GetSource () != g_apAddress || header.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+    {
+        return;
+    }
+    UdpHeader udpHeader;
+    packet->PeekHeader (udpHeader);
+    if (udpHeader.GetSourcePort () == 9)
+    {
+        ++g_repliesReceived;
+    }
+}
+
+// Builds the two node scenario with the STA placed xDistance meters away
+// from the AP, everything but the echo client.
+void
+BuildScenario (double xDistance, bool verbose)
 {
-    bool verbose = true;
     uint32_t nWifi = 2;
-    /** Change this parameter and verify the output */
-    double xDistance = 116.0;
-    
-    CommandLine cmd;
-    cmd.AddValue ("xDistance", "Distance between two nodes along x-axis", xDistance);
-    
-    cmd.Parse (argc,argv);
+    g_repliesReceived = 0;
+
     if (verbose)
     {
         LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
         LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
     }
+    
     // 1. Create the nodes and hold them in a container
     NodeContainer wifiStaNodes,
     wifiApNode;
     
     wifiStaNodes.Create (nWifi);
     wifiApNode = wifiStaNodes.Get (0);
+    g_staNode = wifiStaNodes.Get (1);
     // 2. Create channel for communication
     YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
     YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
@@ -104,18 +147,36 @@ main (int argc, char *argv[])
     NqosWifiMacHelper mac = NqosWifiMacHelper::Default ();
     // 3a. Set up MAC for base stations
     Ssid ssid = Ssid ("ns-3-ssid");
-    mac.SetType ("ns3::StaWifiMac",
-                 "Ssid", SsidValue (ssid),
-                 "ActiveProbing", BooleanValue (false));
+    if (g_preAssociated)
+    {
+        PreAssociatedWifiHelper::ConfigureSta (mac, ssid);
+    }
+    else
+    {
+        mac.SetType ("ns3::StaWifiMac",
+                     "Ssid", SsidValue (ssid),
+                     "ActiveProbing", BooleanValue (false));
+    }
     NetDeviceContainer staDevices;
     staDevices = wifi.Install (phy, mac, wifiStaNodes.Get (1));
     // 3b. Set up MAC for AP
-    mac.SetType ("ns3::ApWifiMac",
-                 "Ssid", SsidValue (ssid),
-                 "BeaconGeneration", BooleanValue (true),
-                 "BeaconInterval", TimeValue (Seconds (5)));
+    if (g_preAssociated)
+    {
+        PreAssociatedWifiHelper::ConfigureAp (mac, ssid, Seconds (5));
+    }
+    else
+    {
+        mac.SetType ("ns3::ApWifiMac",
+                     "Ssid", SsidValue (ssid),
+                     "BeaconGeneration", BooleanValue (true),
+                     "BeaconInterval", TimeValue (Seconds (5)));
+    }
     NetDeviceContainer apDevice;
     apDevice = wifi.Install (phy, mac, wifiApNode);
+    if (g_preAssociated)
+    {
+        PreAssociatedWifiHelper::StopBeaconsWhenAssociated (apDevice, staDevices);
+    }
     // 4. Set mobility of the nodes
     MobilityHelper mobility;
     // All space coordinates in meter
@@ -139,30 +200,293 @@ main (int argc, char *argv[])
     address.SetBase ("10.1.1.0", "255.255.255.0");
     wifiApInterface = address.Assign (apDevice);
     wifiInterfaces = address.Assign (staDevices);
+    g_apAddress = wifiApInterface.GetAddress (0);
     // 7a. Create and setup applications (traffic sink)
     UdpEchoServerHelper echoServer (9); // Port # 9
     ApplicationContainer serverApps = echoServer.Install (wifiApNode);
     serverApps.Start (Seconds (1.0));
     serverApps.Stop (Seconds (4.0));
-    // 7b. Create and setup applications (traffic source)
-    UdpEchoClientHelper echoClient (wifiApInterface.GetAddress (0), 9);
-    echoClient.SetAttribute ("MaxPackets", UintegerValue (1));
-    echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.)));
-    echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
-    ApplicationContainer clientApps = echoClient.Install (wifiStaNodes.Get (1)); 
-    clientApps.Start (Seconds (2.0));
-    clientApps.Stop (Seconds (3.0));
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
     Simulator::Stop (Seconds (4.0));
+
+    std::ostringstream oss;
+    oss << "/NodeList/" << g_staNode->GetId () << "/$ns3::Ipv4L3Protocol/LocalDeliver";
+    Config::ConnectWithoutContext (oss.str (), MakeCallback (&EchoReplyDelivered));
     // 8. Enable tracing (optional)
-    //phy.EnablePcapAll ("wifi-2-nodes-fixed", true);
+    if (g_tracing)
+    {
+        phy.EnablePcapAll ("wifi-2-nodes-fixed", true);
+    }
     
-    PrintAddresses(wifiInterfaces, "IP addresses of base stations");
-    PrintAddresses(wifiApInterface, "IP address of AP");
-    PrintLocations(wifiStaNodes, "Location of all nodes");
+    if (verbose)
+    {
+        PrintAddresses(wifiInterfaces, "IP addresses of base stations");
+        PrintAddresses(wifiApInterface, "IP address of AP");
+        PrintLocations(wifiStaNodes, "Location of all nodes");
+    }
+}
+
+// 7b. Create and setup applications (traffic source).  Start and stop are
+// relative to the current simulation time, as for any application added to
+// a node once the simulation is running.
+void
+InstallClient (uint32_t packetSize, Time start, Time stop)
+{
+    UdpEchoRttClientHelper echoClient (g_apAddress, 9, g_rtt);
+    echoClient.SetAttribute ("MaxPackets", UintegerValue (1));
+    echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.)));
+    echoClient.SetAttribute ("PacketSize", UintegerValue (packetSize));
+    ApplicationContainer clientApps = echoClient.Install (g_staNode); 
+    clientApps.Start (start);
+    clientApps.Stop (stop);
+}
+
+// Runs the whole scenario once and returns true if the STA got its echo back.
+bool
+RunScenario (double xDistance, bool verbose)
+{
+    BuildScenario (xDistance, verbose);
+    InstallClient (1024, Seconds (2.0), Seconds (3.0));
+    FlowStatsCollector flows;
+    if (!g_flowStats.empty ())
+    {
+        flows.Install ();
+    }
     
     Simulator::Run ();
+    if (g_rtt)
+    {
+        UdpEchoRttClientHelper::PrintAll (std::cout);
+    }
+    if (!g_flowStats.empty ())
+    {
+        flows.Write (g_flowStats);
+    }
     Simulator::Destroy ();
+
+    return g_repliesReceived > 0;
+}
+
+uint32_t
+RunDistanceJob (std::vector<double> *distances, uint32_t index)
+{
+    return RunScenario ((*distances)[index], false) ? 1 : 0;
+}
+
+// A child that crashed or was killed says nothing about reachability, so
+// a bound taken from it would be wrong; reports the first such distance.
+bool
+AllJobsSucceeded (const std::vector<double> &distances, const std::vector<uint32_t> &reached)
+{
+    for (uint32_t i = 0; i < reached.size (); ++i)
+    {
+        if (reached[i] == ForkSweep::FAILED)
+        {
+            std::cout << "Run at " << distances[i] << " m failed, sweep abandoned" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bisects [minDistance, maxDistance] for the largest distance at which the
+// echo still comes back.  Each round splits the current interval into
+// nJobs + 1 pieces and tries all the inner points at once, each in its own
+// process, so the interval shrinks by a factor of nJobs + 1 per round
+// instead of 2.
+void
+SweepRange (double minDistance, double maxDistance, double tolerance, uint32_t nJobs)
+{
+    ForkSweep sweep (nJobs);
+    std::vector<double> ends;
+    ends.push_back (minDistance);
+    ends.push_back (maxDistance);
+    std::vector<uint32_t> reachedEnds = sweep.Run (ends.size (), MakeBoundCallback (&RunDistanceJob, &ends));
+    if (!AllJobsSucceeded (ends, reachedEnds))
+    {
+        return;
+    }
+    if (reachedEnds[0] != 1)
+    {
+        std::cout << "No reply even at " << minDistance << " m" << std::endl;
+        return;
+    }
+    if (reachedEnds[1] == 1)
+    {
+        std::cout << "Reply still received at " << maxDistance << " m, "
+                  << "raise --sweepMax" << std::endl;
+        return;
+    }
+
+    double lo = minDistance;
+    double hi = maxDistance;
+    uint32_t round = 0;
+    while (hi - lo > tolerance)
+    {
+        std::vector<double> candidates;
+        for (uint32_t i = 1; i <= nJobs; ++i)
+        {
+            candidates.push_back (lo + (hi - lo) * i / (nJobs + 1));
+        }
+        std::vector<uint32_t> reached = sweep.Run (candidates.size (), MakeBoundCallback (&RunDistanceJob, &candidates));
+        if (!AllJobsSucceeded (candidates, reached))
+        {
+            return;
+        }
+
+        // Reachability is monotonic in the distance: the first candidate
+        // without a reply bounds the range from above.
+        double newLo = lo;
+        double newHi = hi;
+        for (uint32_t i = 0; i < candidates.size (); ++i)
+        {
+            if (reached[i] != 1)
+            {
+                newHi = candidates[i];
+                break;
+            }
+            newLo = candidates[i];
+        }
+        lo = newLo;
+        hi = newHi;
+        std::cout << "Round " << ++round << ": range is in [" << lo << ", " << hi << ") m" << std::endl;
+    }
+    std::cout << "Maximum distance with two way communication: " << lo << " m" << std::endl;
+}
+
+struct SnapshotSweep
+{
+    std::string parameter;
+    std::vector<double> values;
+};
+
+// Runs in a child forked from the warmed up scenario: applies one value of
+// the swept parameter, adds the echo client and finishes the run.
+uint32_t
+RunSnapshotJob (SnapshotSweep *sweep, uint32_t index)
+{
+    double value = sweep->values[index];
+    uint32_t packetSize = 1024;
+    Time start = Seconds (2.0);
+    if (sweep->parameter == "distance")
+    {
+        g_staNode->GetObject<MobilityModel> ()->SetPosition (Vector (value, 0.0, 0.0));
+    }
+    else if (sweep->parameter == "packetSize")
+    {
+        packetSize = StationEchoSweep::ToPacketSize (value);
+    }
+    else
+    {
+        start = Seconds (value);
+    }
+    // The server stops at 4 s, so the one second client window must end by then.
+    NS_ABORT_MSG_IF (start < Simulator::Now () || start > Seconds (3.0),
+                     "Client start time " << start.GetSeconds () << " s is outside ["
+                     << Simulator::Now ().GetSeconds () << ", 3] s");
+
+    InstallClient (packetSize, start - Simulator::Now (), start + Seconds (1.0) - Simulator::Now ());
+    Simulator::Run ();
+    return g_repliesReceived;
+}
+
+// Builds the scenario and runs it up to forkAt, by which time the STA has
+// heard the first beacon and associated, then forks one child per value.
+// With parameter "distance" the STA is moved after association, so this
+// measures how far an associated STA can be, not how far it can associate.
+void
+SweepFromSnapshot (double xDistance, double forkAt, SnapshotSweep &sweep, uint32_t nJobs)
+{
+    NS_ABORT_MSG_UNLESS (sweep.parameter == "distance" || sweep.parameter == "packetSize"
+                         || sweep.parameter == "startTime",
+                         "Unknown sweep parameter \"" << sweep.parameter << "\"");
+    if (sweep.parameter == "packetSize")
+    {
+        // Before forking, so that a bad value is not just a failed child
+        for (uint32_t i = 0; i < sweep.values.size (); ++i)
+        {
+            StationEchoSweep::ToPacketSize (sweep.values[i]);
+        }
+    }
+    BuildScenario (xDistance, false);
+    Simulator::Stop (Seconds (forkAt));
+    Simulator::Run ();
+
+    std::vector<uint32_t> replies = ForkSweep (nJobs).Run (sweep.values.size (), MakeBoundCallback (&RunSnapshotJob, &sweep));
+    std::cout << sweep.parameter << "\treplies" << std::endl;
+    for (uint32_t i = 0; i < replies.size (); ++i)
+    {
+        std::cout << sweep.values[i] << "\t";
+        if (replies[i] == ForkSweep::FAILED)
+        {
+            std::cout << "failed" << std::endl;
+        }
+        else
+        {
+            std::cout << replies[i] << std::endl;
+        }
+    }
+    Simulator::Destroy ();
+}
+
+int
+main (int argc, char *argv[])
+{
+    bool verbose = true;
+    /** Change this parameter and verify the output */
+    double xDistance = 116.0;
+    bool sweep = false;
+    double sweepMin = 1.0;
+    double sweepMax = 1000.0;
+    double sweepTolerance = 0.1;
+    uint32_t sweepJobs = 0;
+    double forkAt = 1.5;
+    SnapshotSweep snapshotSweep;
+    std::string sweepValues;
+    uint32_t nPackets = 0;
+    std::string benchOutput = "";
+    std::string profileEvents = "";
+    
+    CommandLine cmd;
+    cmd.AddValue ("xDistance", "Distance between two nodes along x-axis", xDistance);
+    cmd.AddValue ("sweep", "Search for the maximum distance instead of running once", sweep);
+    cmd.AddValue ("sweepMin", "Smallest distance tried by the sweep", sweepMin);
+    cmd.AddValue ("sweepMax", "Largest distance tried by the sweep", sweepMax);
+    cmd.AddValue ("sweepTolerance", "Stop the sweep once the range is known to this many meters", sweepTolerance);
+    cmd.AddValue ("sweepJobs", "Runs done at the same time by a sweep (0 = one per core)", sweepJobs);
+    cmd.AddValue ("sweepParam", "Parameter swept from a warmed up snapshot: distance, packetSize or startTime", snapshotSweep.parameter);
+    cmd.AddValue ("sweepValues", "Comma separated values for --sweepParam", sweepValues);
+    cmd.AddValue ("forkAt", "Simulation time (s) at which the snapshot is taken", forkAt);
+    cmd.AddValue ("preAssociated", "Associate the stations at start-up and stop the beacons once they are", g_preAssociated);
+    cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+    cmd.AddValue ("tracing", "Write pcap files of the Wi-Fi devices", g_tracing);
+    cmd.AddValue ("nPackets", "Packets sent by the echo client of a single run (0 = one)", nPackets);
+    cmd.AddValue ("benchOutput", "Append wall time, events, memory and allocations of a single run to this file", benchOutput);
+    cmd.AddValue ("profileEvents", "Write the wall time of each kind of event to this file, as folded stacks for flamegraph.pl", profileEvents);
+    cmd.AddValue ("flowStats", "Write per-flow packet, delay and jitter counters of a single run to this file (CSV, or JSON if it ends in .json)", g_flowStats);
+    cmd.AddValue ("rtt", "The echo client measures round trip times into a histogram, instead of logging each packet", g_rtt);
+    
+    cmd.Parse (argc,argv);
+    if (sweep)
+    {
+        SweepRange (sweepMin, sweepMax, sweepTolerance,
+                    sweepJobs == 0 ? ForkSweep::GetDefaultJobs () : sweepJobs);
+        return 0;
+    }
+    if (!snapshotSweep.parameter.empty ())
+    {
+        snapshotSweep.values = ForkSweep::ParseValues (sweepValues);
+        SweepFromSnapshot (xDistance, forkAt, snapshotSweep, sweepJobs);
+        return 0;
+    }
+    
+    if (!profileEvents.empty ())
+    {
+        ProfilingScheduler::Enable (profileEvents);
+    }
+    ScenarioBench bench ("Game", benchOutput, argc, argv);
+    bench.SetPackets (nPackets);
+    RunScenario (xDistance, verbose);
     
     return 0;
 }
@@ -23,6 +23,14 @@
 #include "ns3/csma-module.h"
 #include "ns3/internet-module.h"
 
+#include "flow-stats-collector.h"
+#include "ipv4-on-demand-routing.h"
+#include "quiescence-monitor.h"
+#include "profiling-scheduler.h"
+#include "scenario-bench.h"
+#include "spf-routing-helper.h"
+#include "udp-echo-rtt-client.h"
+
 // Default Network Topology
 //
 //   Wifi 10.1.3.0
@@ -55,6 +63,14 @@ main (int argc, char *argv[])
   // Same as nWifi
   uint32_t nCsma = 3;
   uint32_t nWifi = 3;
+  std::string routing = "global";
+  bool autoStop = false;
+  bool tracing = true;
+  uint32_t nPackets = 0;
+  std::string benchOutput = "";
+  std::string profileEvents = "";
+  std::string flowStats = "";
+  bool rtt = false;
 
   // Adding Command line arguments here.
   // Use $ ./waf --run "scratch/mysecond --PrintHelp" to see help.
@@ -63,9 +79,24 @@ main (int argc, char *argv[])
   cmd.AddValue ("nCsma", "Number of \"extra\" CSMA nodes/devices", nCsma);
   cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
   cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+  cmd.AddValue ("routing", "How routes are computed: global (Ipv4GlobalRoutingHelper), spf (parallel SpfRoutingHelper) or on-demand (first use, cached per node)", routing);
+  cmd.AddValue ("autoStop", "End the run once the echo clients are done and the network is idle", autoStop);
+  cmd.AddValue ("tracing", "Write the pcap files", tracing);
+  cmd.AddValue ("nPackets", "Packets sent by the echo client (0 = one)", nPackets);
+  cmd.AddValue ("benchOutput", "Append wall time, events, memory and allocations of the run to this file", benchOutput);
+  cmd.AddValue ("profileEvents", "Write the wall time of each kind of event to this file, as folded stacks for flamegraph.pl", profileEvents);
+  cmd.AddValue ("flowStats", "Write per-flow packet, delay and jitter counters to this file (CSV, or JSON if it ends in .json)", flowStats);
+  cmd.AddValue ("rtt", "Echo clients measure round trip times into histograms, instead of logging each packet", rtt);
 
   cmd.Parse (argc,argv);
 
+  if (!profileEvents.empty ())
+    {
+      ProfilingScheduler::Enable (profileEvents);
+    }
+  ScenarioBench bench ("MyThirdExample", benchOutput, argc, argv);
+  bench.SetPackets (nPackets);
+
   if (nWifi > 18)
     {
       std::cout << "Number of wifi nodes " << nWifi << 
@@ -193,7 +224,7 @@ main (int argc, char *argv[])
   serverApps.Start (Seconds (1.0));
   serverApps.Stop (Seconds (10.0));
 
-  UdpEchoClientHelper echoClient (csmaInterfaces.GetAddress (nCsma), 9);
+  UdpEchoRttClientHelper echoClient (csmaInterfaces.GetAddress (nCsma), 9, rtt);
   echoClient.SetAttribute ("MaxPackets", UintegerValue (1));
   echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
   echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
@@ -204,14 +235,35 @@ main (int argc, char *argv[])
   clientApps.Stop (Seconds (10.0));
 
   // Set the global routing because the packets have to be routed to the dentination.
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  SpfRoutingHelper spf;
+  Ipv4OnDemandRoutingHelper onDemand;
+  if (routing == "spf")
+    {
+      spf.Populate ();
+    }
+  else if (routing == "global")
+    {
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
+  else if (routing == "on-demand")
+    {
+      onDemand.InstallAll ();
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown routing \"" << routing << "\"");
+    }
 
   // wireless access point to generate beacons. It will generate beacons forever
+  // (--autoStop ends the run earlier once the echo traffic is over)
   Simulator::Stop (Seconds (10.0));
 
-  pointToPoint.EnablePcapAll ("third");
-  phy.EnablePcap ("third", apDevices.Get (0));
-  csma.EnablePcap ("third", csmaDevices.Get (0), true);
+  if (tracing)
+    {
+      pointToPoint.EnablePcapAll ("third");
+      phy.EnablePcap ("third", apDevices.Get (0));
+      csma.EnablePcap ("third", csmaDevices.Get (0), true);
+    }
 
   std::ostringstream oss;
   oss <<
@@ -220,7 +272,31 @@ main (int argc, char *argv[])
     
   Config::Connect (oss.str (), MakeCallback (&CourseChange));
     
+  QuiescenceMonitor quiescence;
+  if (autoStop)
+    {
+      quiescence.Enable ();
+    }
+
+  FlowStatsCollector flows;
+  if (!flowStats.empty ())
+    {
+      flows.Install ();
+    }
+
   Simulator::Run ();
+  if (rtt)
+    {
+      UdpEchoRttClientHelper::PrintAll (std::cout);
+    }
+  if (routing == "on-demand")
+    {
+      Ipv4OnDemandRouting::PrintStats (std::cout);
+    }
+  if (!flowStats.empty ())
+    {
+      flows.Write (flowStats);
+    }
   Simulator::Destroy ();
   return 0;
 }
@@ -0,0 +1,481 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <stdint.h>
+#include <malloc.h>
+#include <sys/mman.h>
+
+namespace ns3 {
+
+/**
+ * Heap allocation counters for the whole process.
+ *
+ * Including this header replaces the global operator new and delete, for
+ * the ns-3 libraries as well as the program, so it must be included by a
+ * single translation unit; every program in this directory is one file.
+ * Nothing is counted until EnableCounting is called, so that a program
+ * that does not report them only pays for a test of a plain flag.  The
+ * counters themselves are relaxed atomics, since the pcap writer and the
+ * SPF workers allocate from their own threads.  EnableHeapBytes further
+ * tracks the bytes held on the heap, as malloc or the slabs size the
+ * blocks, at the cost of a malloc_usable_size call per allocation and
+ * free.
+ *
+ * Once EnableSlabs is called, allocations of up to 4 KiB, which is where
+ * Packet, Buffer data, tag lists and metadata land, are served from size
+ * class slabs instead of malloc.  Slabs are 64 KiB chunks carved out of a
+ * single reserved address range, so a free tells slab blocks from malloc
+ * blocks by address and needs no header.  Each thread has its own free
+ * list per class; a thread that frees more than it allocates, like the
+ * pcap writer, hands batches of blocks to a shared depot, from which the
+ * other threads refill before carving new chunks.  Memory never goes back
+ * to the system, and slabs cannot be turned off again.
+ */
+class AllocStats
+{
+public:
+  struct Counts
+  {
+    uint64_t allocations;
+    uint64_t frees;
+    // Requested by operator new, not what malloc actually used
+    uint64_t bytes;
+  };
+
+  /**
+   * Counts allocations from now on; call from the main thread before any
+   * other is started, and before EnableSlabs.
+   */
+  static void
+  EnableCounting (void)
+  {
+    s_counting = true;
+  }
+
+  static Counts
+  Get (void)
+  {
+    Counts c;
+    c.allocations = s_allocations.load (std::memory_order_relaxed);
+    c.frees = s_frees.load (std::memory_order_relaxed);
+    c.bytes = s_bytes.load (std::memory_order_relaxed);
+    return c;
+  }
+
+  /**
+   * Tracks the bytes held on the heap from now on, as well as counting;
+   * same restrictions as EnableCounting.
+   */
+  static void
+  EnableHeapBytes (void)
+  {
+    EnableCounting ();
+    s_heapBytes = true;
+  }
+
+  struct HeapCounts
+  {
+    // Held now and at most since ResetHeapPeak.  Blocks allocated before
+    // EnableHeapBytes are not counted when freed either, so only
+    // differences mean anything.
+    int64_t live;
+    int64_t peak;
+  };
+
+  static HeapCounts
+  GetHeap (void)
+  {
+    HeapCounts c;
+    c.live = s_heapLive.load (std::memory_order_relaxed);
+    c.peak = s_heapPeak.load (std::memory_order_relaxed);
+    return c;
+  }
+
+  static void
+  ResetHeapPeak (void)
+  {
+    s_heapPeak.store (s_heapLive.load (std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+
+  struct SlabCounts
+  {
+    // Slab blocks in use, now and at most, if counting
+    uint64_t live;
+    uint64_t peak;
+    uint64_t chunks;
+  };
+
+  static SlabCounts
+  GetSlabs (void)
+  {
+    SlabCounts c;
+    c.live = s_slabLive.load (std::memory_order_relaxed);
+    c.peak = s_slabPeak.load (std::memory_order_relaxed);
+    c.chunks = std::min<uint64_t> (s_slabChunks.load (std::memory_order_relaxed), ARENA_SIZE / CHUNK_SIZE);
+    return c;
+  }
+
+  /**
+   * Serves small allocations from slabs from now on; call from the main
+   * thread before any other is started.  Returns false if the address
+   * range cannot be reserved, in which case malloc is kept.
+   */
+  static bool
+  EnableSlabs (void)
+  {
+    if (s_arena == 0)
+      {
+        void *arena = mmap (0, ARENA_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (arena == MAP_FAILED)
+          {
+            return false;
+          }
+        s_arena = reinterpret_cast<uintptr_t> (arena);
+      }
+    return true;
+  }
+
+  static void *
+  Allocate (std::size_t size)
+  {
+    if (s_counting)
+      {
+        s_allocations.fetch_add (1, std::memory_order_relaxed);
+        s_bytes.fetch_add (size, std::memory_order_relaxed);
+      }
+    if (s_arena != 0 && size <= MAX_SLAB_SIZE)
+      {
+        uint32_t c = GetClass (size);
+        void *block = SlabAllocate (c);
+        if (block != 0)
+          {
+            if (s_heapBytes)
+              {
+                AddHeapBytes (GetClassSize (c));
+              }
+            return block;
+          }
+      }
+    void *p;
+    while ((p = std::malloc (size == 0 ? 1 : size)) == 0)
+      {
+        std::new_handler handler = std::get_new_handler ();
+        if (handler == 0)
+          {
+            throw std::bad_alloc ();
+          }
+        handler ();
+      }
+    if (s_heapBytes)
+      {
+        AddHeapBytes (malloc_usable_size (p));
+      }
+    return p;
+  }
+
+  static void
+  Free (void *p)
+  {
+    if (p == 0)
+      {
+        return;
+      }
+    if (s_counting)
+      {
+        s_frees.fetch_add (1, std::memory_order_relaxed);
+      }
+    uintptr_t offset = reinterpret_cast<uintptr_t> (p) - s_arena;
+    if (s_arena != 0 && offset < ARENA_SIZE)
+      {
+        if (s_heapBytes)
+          {
+            AddHeapBytes (-int64_t (GetClassSize (GetChunkClass (offset))));
+          }
+        SlabFree (p, offset);
+      }
+    else
+      {
+        if (s_heapBytes)
+          {
+            AddHeapBytes (-int64_t (malloc_usable_size (p)));
+          }
+        std::free (p);
+      }
+  }
+
+private:
+  static const std::size_t ARENA_SIZE = std::size_t (1) << 36;
+  static const std::size_t CHUNK_SIZE = 64 * 1024;
+  // Start of the blocks in a chunk, past the class number
+  static const std::size_t CHUNK_HEADER = 16;
+  static const std::size_t MAX_SLAB_SIZE = 4096;
+  static const uint32_t CLASSES = 18;
+  // Blocks a thread keeps per class before handing them to the depot
+  static const uint32_t BATCH = 64;
+
+  struct FreeBlock
+  {
+    FreeBlock *next;
+    // Next batch in the depot, set on the first block of a batch
+    FreeBlock *nextBatch;
+  };
+
+  struct FreeList
+  {
+    FreeBlock *head;
+    uint32_t count;
+  };
+
+  struct Depot
+  {
+    std::mutex mutex;
+    FreeBlock *batches;
+  };
+
+  static std::size_t
+  GetClassSize (uint32_t c)
+  {
+    // 16 to 128 in steps of 16, then 1.5 and 2 times powers of two
+    static const uint32_t large[] = { 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096 };
+    return c < 8 ? (c + 1) * 16 : large[c - 8];
+  }
+
+  static uint32_t
+  GetClass (std::size_t size)
+  {
+    if (size <= 128)
+      {
+        return size == 0 ? 0 : (size - 1) / 16;
+      }
+    uint32_t c = 8;
+    while (GetClassSize (c) < size)
+      {
+        ++c;
+      }
+    return c;
+  }
+
+  static void
+  AddHeapBytes (int64_t bytes)
+  {
+    int64_t live = s_heapLive.fetch_add (bytes, std::memory_order_relaxed) + bytes;
+    int64_t peak = s_heapPeak.load (std::memory_order_relaxed);
+    while (live > peak && !s_heapPeak.compare_exchange_weak (peak, live, std::memory_order_relaxed))
+      {
+      }
+  }
+
+  // Size class of the chunk the slab block at offset is in
+  static uint32_t
+  GetChunkClass (uintptr_t offset)
+  {
+    return *reinterpret_cast<uint32_t *> (s_arena + offset - offset % CHUNK_SIZE);
+  }
+
+  static void *
+  SlabAllocate (uint32_t c)
+  {
+    FreeList &list = t_free[c];
+    if (list.head == 0 && !Refill (c))
+      {
+        return 0;
+      }
+    FreeBlock *block = list.head;
+    list.head = block->next;
+    --list.count;
+    if (s_counting)
+      {
+        uint64_t live = s_slabLive.fetch_add (1, std::memory_order_relaxed) + 1;
+        uint64_t peak = s_slabPeak.load (std::memory_order_relaxed);
+        while (live > peak && !s_slabPeak.compare_exchange_weak (peak, live, std::memory_order_relaxed))
+          {
+          }
+      }
+    return block;
+  }
+
+  static void
+  SlabFree (void *p, uintptr_t offset)
+  {
+    uint32_t c = GetChunkClass (offset);
+    FreeList &list = t_free[c];
+    FreeBlock *block = static_cast<FreeBlock *> (p);
+    block->next = list.head;
+    list.head = block;
+    ++list.count;
+    if (s_counting)
+      {
+        s_slabLive.fetch_sub (1, std::memory_order_relaxed);
+      }
+    if (list.count >= 2 * BATCH)
+      {
+        // The first BATCH blocks go, the older ones stay
+        FreeBlock *last = list.head;
+        for (uint32_t i = 1; i < BATCH; ++i)
+          {
+            last = last->next;
+          }
+        FreeBlock *batch = list.head;
+        list.head = last->next;
+        list.count -= BATCH;
+        last->next = 0;
+        std::lock_guard<std::mutex> lock (s_depots[c].mutex);
+        batch->nextBatch = s_depots[c].batches;
+        s_depots[c].batches = batch;
+      }
+  }
+
+  /**
+   * Fills the empty free list of this thread for class c from the depot,
+   * or else from a new chunk; false once the arena is used up.
+   */
+  static bool
+  Refill (uint32_t c)
+  {
+    FreeList &list = t_free[c];
+    {
+      std::lock_guard<std::mutex> lock (s_depots[c].mutex);
+      FreeBlock *batch = s_depots[c].batches;
+      if (batch != 0)
+        {
+          s_depots[c].batches = batch->nextBatch;
+          list.head = batch;
+          list.count = BATCH;
+          return true;
+        }
+    }
+    uint64_t chunk = s_slabChunks.fetch_add (1, std::memory_order_relaxed);
+    if ((chunk + 1) * CHUNK_SIZE > ARENA_SIZE)
+      {
+        return false;
+      }
+    uintptr_t start = s_arena + chunk * CHUNK_SIZE;
+    *reinterpret_cast<uint32_t *> (start) = c;
+    std::size_t size = GetClassSize (c);
+    for (uintptr_t b = start + CHUNK_HEADER; b + size <= start + CHUNK_SIZE; b += size)
+      {
+        FreeBlock *block = reinterpret_cast<FreeBlock *> (b);
+        block->next = list.head;
+        list.head = block;
+        ++list.count;
+      }
+    return true;
+  }
+
+  // Set once, before the threads that read it are started
+  static bool s_counting;
+  static bool s_heapBytes;
+  static std::atomic<uint64_t> s_allocations;
+  static std::atomic<uint64_t> s_frees;
+  static std::atomic<uint64_t> s_bytes;
+  static std::atomic<int64_t> s_heapLive;
+  static std::atomic<int64_t> s_heapPeak;
+  static uintptr_t s_arena;
+  static std::atomic<uint64_t> s_slabChunks;
+  static std::atomic<uint64_t> s_slabLive;
+  static std::atomic<uint64_t> s_slabPeak;
+  static Depot s_depots[CLASSES];
+  static thread_local FreeList t_free[CLASSES];
+};
+
+bool AllocStats::s_counting = false;
+bool AllocStats::s_heapBytes = false;
+std::atomic<uint64_t> AllocStats::s_allocations (0);
+std::atomic<uint64_t> AllocStats::s_frees (0);
+std::atomic<uint64_t> AllocStats::s_bytes (0);
+std::atomic<int64_t> AllocStats::s_heapLive (0);
+std::atomic<int64_t> AllocStats::s_heapPeak (0);
+uintptr_t AllocStats::s_arena = 0;
+std::atomic<uint64_t> AllocStats::s_slabChunks (0);
+std::atomic<uint64_t> AllocStats::s_slabLive (0);
+std::atomic<uint64_t> AllocStats::s_slabPeak (0);
+AllocStats::Depot AllocStats::s_depots[AllocStats::CLASSES];
+thread_local AllocStats::FreeList AllocStats::t_free[AllocStats::CLASSES];
+
+} // namespace ns3
+
+void *
+operator new (std::size_t size)
+{
+  return ns3::AllocStats::Allocate (size);
+}
+
+void *
+operator new[] (std::size_t size)
+{
+  return ns3::AllocStats::Allocate (size);
+}
+
+void *
+operator new (std::size_t size, const std::nothrow_t &) noexcept
+{
+  try
+    {
+      return ns3::AllocStats::Allocate (size);
+    }
+  catch (const std::bad_alloc &)
+    {
+      return 0;
+    }
+}
+
+void *
+operator new[] (std::size_t size, const std::nothrow_t &) noexcept
+{
+  try
+    {
+      return ns3::AllocStats::Allocate (size);
+    }
+  catch (const std::bad_alloc &)
+    {
+      return 0;
+    }
+}
+
+void
+operator delete (void *p) noexcept
+{
+  ns3::AllocStats::Free (p);
+}
+
+void
+operator delete[] (void *p) noexcept
+{
+  ns3::AllocStats::Free (p);
+}
+
+void
+operator delete (void *p, const std::nothrow_t &) noexcept
+{
+  ns3::AllocStats::Free (p);
+}
+
+void
+operator delete[] (void *p, const std::nothrow_t &) noexcept
+{
+  ns3::AllocStats::Free (p);
+}
+
+#endif /* ALLOC_STATS_H */
@@ -0,0 +1,789 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ASYNC_PCAP_HELPER_H
+#define ASYNC_PCAP_HELPER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/csma-module.h"
+
+#include "packet-filter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+/**
+ * An output file, optionally compressed in the gzip or zstd format.
+ *
+ * Scratch programs only link against ns-3, so zlib and libzstd are loaded
+ * at run time, the first time a file asks for them, and neither zlib.h nor
+ * zstd.h is needed to build; Check tells up front whether loading works.
+ * dlopen lives in libdl before glibc 2.34, so on older systems the program
+ * has to be linked with -ldl (ns-3 itself does not pull it in).
+ *
+ * Write and Finish are called from the writer thread of AsyncPcapHelper
+ * and never abort: the first error is kept, later bytes are dropped, and
+ * the owner reports it once the run is over.
+ */
+class PcapFileStream
+{
+public:
+  enum Compression
+  {
+    NONE,
+    GZIP,
+    ZSTD
+  };
+
+  /**
+   * \returns why files can't be compressed that way, or "" if they can
+   */
+  static std::string
+  Check (Compression compression)
+  {
+    if (compression == GZIP && GetZlib ().deflate == 0)
+      {
+        return "gzip compression needs libz.so.1";
+      }
+    if (compression == ZSTD && GetZstd ().compressStream == 0)
+      {
+        return "zstd compression needs libzstd.so.1";
+      }
+    return "";
+  }
+
+  PcapFileStream (std::string filename, Compression compression)
+    : m_filename (filename),
+      m_compression (compression),
+      m_zstd (0)
+  {
+    std::string unavailable = Check (compression);
+    NS_ABORT_MSG_UNLESS (unavailable.empty (), unavailable);
+    m_fd = open (filename.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    NS_ABORT_MSG_IF (m_fd < 0, "Unable to open " << filename << ": " << strerror (errno));
+    if (compression == GZIP)
+      {
+        std::memset (&m_zlib, 0, sizeof (m_zlib));
+        // 16 + ZLIB_MAX_WBITS asks for a gzip header and trailer, as gzip -c writes.
+        int status = GetZlib ().deflateInit2_ (&m_zlib, ZLIB_DEFAULT_COMPRESSION, ZLIB_DEFLATED,
+                                               16 + ZLIB_MAX_WBITS, 8, ZLIB_DEFAULT_STRATEGY, "1.2.11",
+                                               sizeof (m_zlib));
+        NS_ABORT_MSG_UNLESS (status == ZLIB_OK, "Unable to start gzip for " << filename);
+      }
+    else if (compression == ZSTD)
+      {
+        m_zstd = GetZstd ().createCStream ();
+        NS_ABORT_MSG_IF (m_zstd == 0 || GetZstd ().isError (GetZstd ().initCStream (m_zstd, 3)),
+                         "Unable to start zstd for " << filename);
+      }
+    if (compression != NONE)
+      {
+        m_out.resize (1 << 17);
+      }
+  }
+
+  ~PcapFileStream ()
+  {
+    Finish ();
+  }
+
+  void
+  Write (const void *data, size_t length)
+  {
+    if (m_fd < 0 || !m_error.empty ())
+      {
+        return;
+      }
+    if (m_compression == GZIP)
+      {
+        m_zlib.next_in = static_cast<uint8_t *> (const_cast<void *> (data));
+        m_zlib.avail_in = length;
+        Deflate (ZLIB_NO_FLUSH);
+      }
+    else if (m_compression == ZSTD)
+      {
+        ZstdIn in = { data, length, 0 };
+        while (in.pos < in.size && m_error.empty ())
+          {
+            ZstdOut out = { &m_out[0], m_out.size (), 0 };
+            size_t status = GetZstd ().compressStream (m_zstd, &out, &in);
+            if (GetZstd ().isError (status))
+              {
+                m_error = std::string ("zstd failed: ") + GetZstd ().getErrorName (status);
+              }
+            WriteFully (&m_out[0], out.pos);
+          }
+      }
+    else
+      {
+        WriteFully (data, length);
+      }
+  }
+
+  /**
+   * Writes the compressor's trailer and closes the file.
+   *
+   * \returns false if anything went wrong with the file, see GetError
+   */
+  bool
+  Finish (void)
+  {
+    if (m_fd < 0)
+      {
+        return m_error.empty ();
+      }
+    if (m_compression == GZIP)
+      {
+        if (m_error.empty ())
+          {
+            m_zlib.avail_in = 0;
+            Deflate (ZLIB_FINISH);
+          }
+        GetZlib ().deflateEnd (&m_zlib);
+      }
+    else if (m_compression == ZSTD)
+      {
+        size_t remaining = 1;
+        while (remaining != 0 && m_error.empty ())
+          {
+            ZstdOut out = { &m_out[0], m_out.size (), 0 };
+            remaining = GetZstd ().endStream (m_zstd, &out);
+            if (GetZstd ().isError (remaining))
+              {
+                m_error = std::string ("zstd failed: ") + GetZstd ().getErrorName (remaining);
+              }
+            WriteFully (&m_out[0], out.pos);
+          }
+        GetZstd ().freeCStream (m_zstd);
+      }
+    if (close (m_fd) != 0 && m_error.empty ())
+      {
+        m_error = strerror (errno);
+      }
+    m_fd = -1;
+    return m_error.empty ();
+  }
+
+  std::string
+  GetFilename (void) const
+  {
+    return m_filename;
+  }
+
+  /// The first error met writing the file, or ""
+  std::string
+  GetError (void) const
+  {
+    return m_error;
+  }
+
+private:
+  // The part of the libzstd ABI used here, which zstd keeps stable, so that
+  // building does not need zstd.h.
+  struct ZstdCStream;
+  struct ZstdIn
+  {
+    const void *src;
+    size_t size;
+    size_t pos;
+  };
+  struct ZstdOut
+  {
+    void *dst;
+    size_t size;
+    size_t pos;
+  };
+
+  // Likewise for zlib: z_stream, field for field, and the constants of
+  // zlib.h used here.  deflateInit2_ only checks the major version.
+  struct ZStream
+  {
+    uint8_t *next_in;
+    unsigned int avail_in;
+    unsigned long total_in;
+    uint8_t *next_out;
+    unsigned int avail_out;
+    unsigned long total_out;
+    const char *msg;
+    void *state;
+    void *(*zalloc) (void *, unsigned int, unsigned int);
+    void (*zfree) (void *, void *);
+    void *opaque;
+    int data_type;
+    unsigned long adler;
+    unsigned long reserved;
+  };
+
+  enum
+  {
+    ZLIB_OK = 0,
+    ZLIB_STREAM_END = 1,
+    ZLIB_STREAM_ERROR = -2,
+    ZLIB_NO_FLUSH = 0,
+    ZLIB_FINISH = 4,
+    ZLIB_DEFLATED = 8,
+    ZLIB_DEFAULT_COMPRESSION = -1,
+    ZLIB_DEFAULT_STRATEGY = 0,
+    ZLIB_MAX_WBITS = 15
+  };
+
+  struct Zlib
+  {
+    int (*deflateInit2_) (ZStream *, int, int, int, int, int, const char *, int);
+    int (*deflate) (ZStream *, int);
+    int (*deflateEnd) (ZStream *);
+  };
+
+  struct Zstd
+  {
+    ZstdCStream *(*createCStream) (void);
+    size_t (*initCStream) (ZstdCStream *, int);
+    size_t (*compressStream) (ZstdCStream *, ZstdOut *, ZstdIn *);
+    size_t (*endStream) (ZstdCStream *, ZstdOut *);
+    size_t (*freeCStream) (ZstdCStream *);
+    unsigned (*isError) (size_t);
+    const char *(*getErrorName) (size_t);
+  };
+
+  // Functions of library, all null if it or any of them is missing
+  template <typename T>
+  static void
+  Load (T &functions, const char *library, const char *const names[], size_t n)
+  {
+    std::memset (&functions, 0, sizeof (functions));
+    void *handle = dlopen (library, RTLD_NOW);
+    if (handle == 0)
+      {
+        return;
+      }
+    void **slots = reinterpret_cast<void **> (&functions);
+    for (size_t i = 0; i < n; ++i)
+      {
+        slots[i] = dlsym (handle, names[i]);
+        if (slots[i] == 0)
+          {
+            std::memset (&functions, 0, sizeof (functions));
+            return;
+          }
+      }
+  }
+
+  static const Zlib &
+  GetZlib (void)
+  {
+    static const char *const names[] = { "deflateInit2_", "deflate", "deflateEnd" };
+    static Zlib zlib;
+    static bool loaded = false;
+    if (!loaded)
+      {
+        Load (zlib, "libz.so.1", names, sizeof (names) / sizeof (names[0]));
+        loaded = true;
+      }
+    return zlib;
+  }
+
+  static const Zstd &
+  GetZstd (void)
+  {
+    static const char *const names[] = { "ZSTD_createCStream", "ZSTD_initCStream", "ZSTD_compressStream",
+                                         "ZSTD_endStream", "ZSTD_freeCStream", "ZSTD_isError",
+                                         "ZSTD_getErrorName" };
+    static Zstd zstd;
+    static bool loaded = false;
+    if (!loaded)
+      {
+        Load (zstd, "libzstd.so.1", names, sizeof (names) / sizeof (names[0]));
+        loaded = true;
+      }
+    return zstd;
+  }
+
+  // Runs deflate until it wants more input (or, with ZLIB_FINISH, is done)
+  void
+  Deflate (int flush)
+  {
+    int status;
+    do
+      {
+        m_zlib.next_out = &m_out[0];
+        m_zlib.avail_out = m_out.size ();
+        status = GetZlib ().deflate (&m_zlib, flush);
+        if (status == ZLIB_STREAM_ERROR)
+          {
+            m_error = "gzip failed";
+            return;
+          }
+        WriteFully (&m_out[0], m_out.size () - m_zlib.avail_out);
+      }
+    while (m_error.empty () && (m_zlib.avail_out == 0 || (flush == ZLIB_FINISH && status != ZLIB_STREAM_END)));
+  }
+
+  void
+  WriteFully (const void *data, size_t length)
+  {
+    const uint8_t *p = static_cast<const uint8_t *> (data);
+    while (length > 0 && m_error.empty ())
+      {
+        ssize_t written = write (m_fd, p, length);
+        if (written < 0 && errno == EINTR)
+          {
+            continue;
+          }
+        if (written < 0)
+          {
+            m_error = strerror (errno);
+            return;
+          }
+        p += written;
+        length -= written;
+      }
+  }
+
+  std::string m_filename;
+  Compression m_compression;
+  int m_fd;
+  ZStream m_zlib;
+  ZstdCStream *m_zstd;
+  std::vector<uint8_t> m_out;
+  std::string m_error;
+};
+
+/**
+ * One pcap file fed through a single producer, single consumer byte ring.
+ *
+ * The simulator thread appends complete records (record header followed by
+ * the captured bytes) and the writer thread of AsyncPcapHelper takes
+ * whatever has accumulated and hands it to write (2) in one go.  Neither
+ * side takes a lock; each only ever moves its own end of the ring.
+ */
+class AsyncPcapFile
+{
+public:
+  AsyncPcapFile (std::string filename, uint32_t dataLinkType, uint32_t snapLen, uint32_t ringSize,
+                 PcapFileStream::Compression compression = PcapFileStream::NONE,
+                 PacketFilter filter = PacketFilter ())
+    : m_file (filename, compression),
+      m_dataLinkType (dataLinkType),
+      m_filter (filter),
+      m_snapLen (snapLen),
+      m_ring (ringSize),
+      m_mask (ringSize - 1),
+      m_head (0),
+      m_tail (0)
+  {
+    NS_ABORT_MSG_UNLESS (ringSize != 0 && (ringSize & m_mask) == 0, "Ring size must be a power of two");
+    NS_ABORT_MSG_UNLESS (ringSize >= 2 * (sizeof (RecordHeader) + snapLen), "Ring too small for the snap length");
+
+    // Same global header as PcapFileWrapper writes: native byte order,
+    // version 2.4, no time zone correction.
+    FileHeader header;
+    header.magic = 0xa1b2c3d4;
+    header.versionMajor = 2;
+    header.versionMinor = 4;
+    header.zone = 0;
+    header.sigFigs = 0;
+    header.snapLen = snapLen;
+    header.network = dataLinkType;
+    m_file.Write (&header, sizeof (header));
+  }
+
+  /**
+   * Finishes the file; called once the writer thread has drained it.
+   *
+   * \returns false if writing it failed, see GetError
+   */
+  bool
+  Close (void)
+  {
+    return m_file.Finish ();
+  }
+
+  std::string
+  GetError (void) const
+  {
+    return m_file.GetFilename () + ": " + m_file.GetError ();
+  }
+
+  /**
+   * Appends one record; called from the simulator thread.  Only blocks if
+   * the writer thread has fallen a whole ring behind.
+   */
+  void
+  Write (Time t, Ptr<const Packet> p)
+  {
+    if (!m_filter.Matches (p, m_dataLinkType))
+      {
+        return;
+      }
+    uint64_t current = t.GetMicroSeconds ();
+    RecordHeader header;
+    header.tsSec = current / 1000000;
+    header.tsUsec = current % 1000000;
+    header.origLen = p->GetSize ();
+    header.inclLen = std::min (header.origLen, m_snapLen);
+
+    uint64_t needed = sizeof (header) + header.inclLen;
+    uint64_t head = m_head.load (std::memory_order_relaxed);
+    while (head + needed - m_tail.load (std::memory_order_acquire) > m_ring.size ())
+      {
+        std::this_thread::yield ();
+      }
+
+    Put (head, reinterpret_cast<const uint8_t *> (&header), sizeof (header));
+    uint64_t offset = (head + sizeof (header)) & m_mask;
+    if (offset + header.inclLen <= m_ring.size ())
+      {
+        p->CopyData (&m_ring[offset], header.inclLen);
+      }
+    else
+      {
+        m_scratch.resize (header.inclLen);
+        p->CopyData (&m_scratch[0], header.inclLen);
+        Put (head + sizeof (header), &m_scratch[0], header.inclLen);
+      }
+    m_head.store (head + needed, std::memory_order_release);
+  }
+
+  /**
+   * Writes out everything appended so far; called from the writer thread.
+   *
+   * \returns false if there was nothing to write
+   */
+  bool
+  Drain (void)
+  {
+    uint64_t head = m_head.load (std::memory_order_acquire);
+    uint64_t tail = m_tail.load (std::memory_order_relaxed);
+    if (head == tail)
+      {
+        return false;
+      }
+    uint64_t start = tail & m_mask;
+    uint64_t length = head - tail;
+    uint64_t first = std::min (length, m_ring.size () - start);
+    m_file.Write (&m_ring[start], first);
+    if (first < length)
+      {
+        m_file.Write (&m_ring[0], length - first);
+      }
+    m_tail.store (head, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    int32_t zone;
+    uint32_t sigFigs;
+    uint32_t snapLen;
+    uint32_t network;
+  };
+
+  struct RecordHeader
+  {
+    uint32_t tsSec;
+    uint32_t tsUsec;
+    uint32_t inclLen;
+    uint32_t origLen;
+  };
+
+  void
+  Put (uint64_t position, const uint8_t *data, uint32_t length)
+  {
+    uint64_t offset = position & m_mask;
+    uint32_t first = std::min<uint64_t> (length, m_ring.size () - offset);
+    std::memcpy (&m_ring[offset], data, first);
+    std::memcpy (&m_ring[0], data + first, length - first);
+  }
+
+  PcapFileStream m_file;
+  uint32_t m_dataLinkType;
+  PacketFilter m_filter;
+  uint32_t m_snapLen;
+  std::vector<uint8_t> m_ring;
+  uint64_t m_mask;
+  std::vector<uint8_t> m_scratch;
+  // Total bytes ever appended and written out; the ring offset is the
+  // value modulo the ring size.
+  std::atomic<uint64_t> m_head;
+  std::atomic<uint64_t> m_tail;
+};
+
+/**
+ * Drop-in replacement for the pcap side of PointToPointHelper and
+ * CsmaHelper that moves file output off the simulator thread.
+ *
+ * Files have the same names and the same bytes as the ones written by
+ * EnablePcap/EnablePcapAll, unless compression is selected: then each file
+ * is compressed in the gzip or zstd format by the writer thread, and gets a
+ * .gz or .zst suffix.  One thread serves every device, however many there
+ * are.  All devices must be enabled before Simulator::Run, and Close must
+ * be called after it to flush what is still buffered and to learn whether
+ * all files made it to disk.
+ */
+class AsyncPcapHelper
+{
+public:
+  typedef PcapFileStream::Compression Compression;
+
+  /**
+   * \param ringSize bytes buffered per device, a power of two
+   * \param compression how files enabled from now on are compressed
+   */
+  AsyncPcapHelper (uint32_t ringSize = 1 << 20, Compression compression = PcapFileStream::NONE)
+    : m_ringSize (ringSize),
+      m_compression (compression),
+      m_snapLen (65535),
+      m_started (false),
+      m_stop (false)
+  {
+    SetCompression (compression);
+  }
+
+  /**
+   * Parses "none", "gzip" or "zstd", as given on a command line.
+   */
+  static Compression
+  ParseCompression (std::string name)
+  {
+    if (name == "none" || name.empty ())
+      {
+        return PcapFileStream::NONE;
+      }
+    if (name == "gzip")
+      {
+        return PcapFileStream::GZIP;
+      }
+    if (name == "zstd")
+      {
+        return PcapFileStream::ZSTD;
+      }
+    NS_FATAL_ERROR ("Unknown pcap compression \"" << name << "\"");
+    return PcapFileStream::NONE;
+  }
+
+  void
+  SetCompression (Compression compression)
+  {
+    // Fail now rather than when the first device is enabled
+    std::string unavailable = PcapFileStream::Check (compression);
+    NS_ABORT_MSG_UNLESS (unavailable.empty (), unavailable);
+    m_compression = compression;
+  }
+
+  /**
+   * Keeps at most snapLen bytes of each packet in files enabled from now on.
+   */
+  void
+  SetSnapLen (uint32_t snapLen)
+  {
+    m_snapLen = snapLen;
+  }
+
+  /**
+   * Only packets matching expression (see PacketFilter) are written to
+   * files enabled from now on.
+   */
+  void
+  SetFilter (std::string expression)
+  {
+    m_filter = PacketFilter (expression);
+  }
+
+  ~AsyncPcapHelper ()
+  {
+    Close ();
+  }
+
+  void
+  EnablePcap (std::string prefix, Ptr<NetDevice> nd, bool promiscuous = false)
+  {
+    PcapHelper pcapHelper;
+    std::string filename = pcapHelper.GetFilenameFromDevice (prefix, nd);
+    std::string traceName;
+    uint32_t dataLinkType;
+    if (nd->GetObject<PointToPointNetDevice> () != 0)
+      {
+        // Point-to-point devices only have a promiscuous sniffer.
+        traceName = "PromiscSniffer";
+        dataLinkType = PcapHelper::DLT_PPP;
+      }
+    else if (nd->GetObject<CsmaNetDevice> () != 0)
+      {
+        traceName = promiscuous ? "PromiscSniffer" : "Sniffer";
+        dataLinkType = PcapHelper::DLT_EN10MB;
+      }
+    else
+      {
+        NS_FATAL_ERROR ("AsyncPcapHelper does not know how to capture on " << nd->GetInstanceTypeId ().GetName ());
+      }
+
+    // Compression happens on the writer thread, so it costs the simulator
+    // thread nothing beyond the copy into the ring.
+    if (m_compression == PcapFileStream::GZIP)
+      {
+        filename += ".gz";
+      }
+    else if (m_compression == PcapFileStream::ZSTD)
+      {
+        filename += ".zst";
+      }
+    AsyncPcapFile *file = new AsyncPcapFile (filename, dataLinkType, m_snapLen, m_ringSize, m_compression, m_filter);
+    m_files.push_back (file);
+    nd->TraceConnectWithoutContext (traceName, MakeBoundCallback (&AsyncPcapHelper::Sink, this, file));
+  }
+
+  void
+  EnablePcap (std::string prefix, NetDeviceContainer d, bool promiscuous = false)
+  {
+    for (NetDeviceContainer::Iterator i = d.Begin (); i != d.End (); ++i)
+      {
+        EnablePcap (prefix, *i, promiscuous);
+      }
+  }
+
+  void
+  EnablePcap (std::string prefix, uint32_t nodeid, uint32_t deviceid, bool promiscuous = false)
+  {
+    EnablePcap (prefix, NodeList::GetNode (nodeid)->GetDevice (deviceid), promiscuous);
+  }
+
+  /**
+   * Captures on every device of type T, as T's helper EnablePcapAll does.
+   */
+  template <typename T>
+  void
+  EnablePcapAll (std::string prefix, bool promiscuous = false)
+  {
+    for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+      {
+        for (uint32_t i = 0; i < (*n)->GetNDevices (); ++i)
+          {
+            Ptr<NetDevice> nd = (*n)->GetDevice (i);
+            if (nd->GetObject<T> () != 0)
+              {
+                EnablePcap (prefix, nd, promiscuous);
+              }
+          }
+      }
+  }
+
+  /**
+   * Waits for the writer thread to write out everything and closes the
+   * files.  Files that could not be written in full (disk full, ...) are
+   * reported on std::cerr.
+   *
+   * \returns false if any file could not be written in full
+   */
+  bool
+  Close (void)
+  {
+    if (m_started)
+      {
+        m_stop.store (true, std::memory_order_release);
+        m_writer.join ();
+        m_started = false;
+      }
+    bool ok = true;
+    for (std::vector<AsyncPcapFile *>::iterator i = m_files.begin (); i != m_files.end (); ++i)
+      {
+        if (!(*i)->Close ())
+          {
+            std::cerr << "Unable to write " << (*i)->GetError () << std::endl;
+            ok = false;
+          }
+        delete *i;
+      }
+    m_files.clear ();
+    return ok;
+  }
+
+private:
+  static void
+  Sink (AsyncPcapHelper *helper, AsyncPcapFile *file, Ptr<const Packet> p)
+  {
+    if (!helper->m_started)
+      {
+        helper->Start ();
+      }
+    file->Write (Simulator::Now (), p);
+  }
+
+  void
+  Start (void)
+  {
+    m_started = true;
+    m_writer = std::thread (&AsyncPcapHelper::WriterLoop, this);
+  }
+
+  void
+  WriterLoop (void)
+  {
+    while (true)
+      {
+        // The simulator only asks us to stop once it is done writing, so
+        // an idle pass started after the request means everything is on
+        // disk.
+        bool stopping = m_stop.load (std::memory_order_acquire);
+        bool idle = true;
+        for (std::vector<AsyncPcapFile *>::iterator i = m_files.begin (); i != m_files.end (); ++i)
+          {
+            if ((*i)->Drain ())
+              {
+                idle = false;
+              }
+          }
+        if (idle)
+          {
+            if (stopping)
+              {
+                break;
+              }
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+          }
+      }
+  }
+
+  uint32_t m_ringSize;
+  Compression m_compression;
+  uint32_t m_snapLen;
+  PacketFilter m_filter;
+  std::vector<AsyncPcapFile *> m_files;
+  std::thread m_writer;
+  bool m_started;
+  std::atomic<bool> m_stop;
+};
+
+} // namespace ns3
+
+#endif /* ASYNC_PCAP_HELPER_H */
@@ -0,0 +1,358 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BINARY_TRACE_HELPER_H
+#define BINARY_TRACE_HELPER_H
+
+// Compact binary alternative to the ASCII traces of PointToPointHelper.
+//
+// EnableAsciiAll formats every enqueue, dequeue, drop and receive into a
+// text line, headers and all.  BinaryTraceHelper hooks the same trace
+// sources but appends one fixed size BinaryTraceRecord per event, holding
+// the time, the device, the event and the first bytes of the packet.
+// BinaryTraceReader maps such a file and gives random access to the
+// records; binary-trace-to-ascii.cc turns it back into ASCII trace text.
+//
+// The format can't be chosen on PointToPointHelper itself: its ASCII
+// tracing comes from AsciiTraceHelperForDevice in ns-3, which always
+// writes text to an OutputStreamWrapper.  So this is a helper of its own,
+// enabled in place of EnableAsciiAll, and scripts pick one of the two
+// (myfirst.cc --traceFormat=binary).
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+
+#include "packet-filter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+struct BinaryTraceFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+  uint32_t dataLinkType;
+  uint32_t snapLen;
+  uint8_t reserved[8];
+};
+
+struct BinaryTraceRecord
+{
+  /// Trace source a record came from
+  enum Source
+  {
+    ENQUEUE = 0,
+    DEQUEUE,
+    DROP,
+    MAC_RX,
+    PHY_RX_DROP
+  };
+
+  static const uint32_t SNAP_LEN = 64;
+
+  int64_t timeNs;
+  uint32_t nodeId;
+  uint32_t deviceId;
+  uint32_t packetSize;
+  uint8_t source;
+  uint8_t reserved;
+  uint16_t capturedSize;
+  uint8_t data[SNAP_LEN];
+};
+
+const uint32_t BinaryTraceRecord::SNAP_LEN;
+
+static const char BINARY_TRACE_MAGIC[8] = { 'N', 'S', '3', 'B', 'T', 'R', 'C', '\0' };
+static const uint32_t BINARY_TRACE_VERSION = 1;
+
+/**
+ * Writes binary traces for point-to-point devices.  Enable devices before
+ * Simulator::Run and call Close after it, which reports the first write
+ * error, if any.
+ */
+class BinaryTraceHelper
+{
+public:
+  BinaryTraceHelper ()
+    : m_file (0),
+      m_snapLen (BinaryTraceRecord::SNAP_LEN)
+  {
+  }
+
+  ~BinaryTraceHelper ()
+  {
+    Close ();
+    for (std::vector<Hooked *>::iterator i = m_hooks.begin (); i != m_hooks.end (); ++i)
+      {
+        delete *i;
+      }
+  }
+
+  /**
+   * Opens (and truncates) the trace file all enabled devices write to.
+   */
+  void
+  Open (std::string filename)
+  {
+    Close ();
+    m_file = std::fopen (filename.c_str (), "wb");
+    NS_ABORT_MSG_IF (m_file == 0, "Unable to open " << filename << ": " << std::strerror (errno));
+    m_filename = filename;
+    m_error.clear ();
+    // Records are small and many; let stdio batch them into large writes.
+    m_buffer.resize (1 << 20);
+    std::setvbuf (m_file, &m_buffer[0], _IOFBF, m_buffer.size ());
+
+    BinaryTraceFileHeader header;
+    std::memset (&header, 0, sizeof (header));
+    std::memcpy (header.magic, BINARY_TRACE_MAGIC, sizeof (header.magic));
+    header.version = BINARY_TRACE_VERSION;
+    header.recordSize = sizeof (BinaryTraceRecord);
+    header.dataLinkType = PcapHelper::DLT_PPP;
+    header.snapLen = BinaryTraceRecord::SNAP_LEN;
+    Write (&header, sizeof (header));
+  }
+
+  /**
+   * Keeps at most snapLen (up to SNAP_LEN) bytes of each packet.
+   */
+  void
+  SetSnapLen (uint32_t snapLen)
+  {
+    m_snapLen = std::min (snapLen, BinaryTraceRecord::SNAP_LEN);
+  }
+
+  /**
+   * Only records events for packets matching expression (see
+   * PacketFilter).
+   */
+  void
+  SetFilter (std::string expression)
+  {
+    m_filter = PacketFilter (expression);
+  }
+
+  /**
+   * Traces the same events as PointToPointHelper::EnableAscii for nd.
+   */
+  void
+  Enable (Ptr<NetDevice> nd)
+  {
+    NS_ABORT_MSG_IF (m_file == 0, "BinaryTraceHelper::Open must be called first");
+    Ptr<PointToPointNetDevice> device = nd->GetObject<PointToPointNetDevice> ();
+    NS_ABORT_MSG_IF (device == 0, "BinaryTraceHelper only traces point-to-point devices");
+
+    std::ostringstream oss;
+    oss << "/NodeList/" << nd->GetNode ()->GetId () << "/DeviceList/" << nd->GetIfIndex ()
+        << "/$ns3::PointToPointNetDevice/";
+    Hook (oss.str () + "MacRx", nd, BinaryTraceRecord::MAC_RX);
+    Hook (oss.str () + "TxQueue/Enqueue", nd, BinaryTraceRecord::ENQUEUE);
+    Hook (oss.str () + "TxQueue/Dequeue", nd, BinaryTraceRecord::DEQUEUE);
+    Hook (oss.str () + "TxQueue/Drop", nd, BinaryTraceRecord::DROP);
+    Hook (oss.str () + "PhyRxDrop", nd, BinaryTraceRecord::PHY_RX_DROP);
+  }
+
+  void
+  Enable (NetDeviceContainer d)
+  {
+    for (NetDeviceContainer::Iterator i = d.Begin (); i != d.End (); ++i)
+      {
+        Enable (*i);
+      }
+  }
+
+  /**
+   * Traces every point-to-point device, as EnableAsciiAll does.
+   */
+  void
+  EnableAll (void)
+  {
+    for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+      {
+        for (uint32_t i = 0; i < (*n)->GetNDevices (); ++i)
+          {
+            Ptr<NetDevice> nd = (*n)->GetDevice (i);
+            if (nd->GetObject<PointToPointNetDevice> () != 0)
+              {
+                Enable (nd);
+              }
+          }
+      }
+  }
+
+  /**
+   * Flushes and closes the trace file.  A file that could not be written
+   * in full (disk full, ...) is reported on std::cerr.
+   *
+   * \returns false if the file could not be written in full
+   */
+  bool
+  Close (void)
+  {
+    if (m_file == 0)
+      {
+        return true;
+      }
+    if (std::fclose (m_file) != 0 && m_error.empty ())
+      {
+        m_error = std::strerror (errno);
+      }
+    m_file = 0;
+    if (!m_error.empty ())
+      {
+        std::cerr << "Unable to write " << m_filename << ": " << m_error << std::endl;
+        return false;
+      }
+    return true;
+  }
+
+private:
+  // Everything a sink needs to know about where an event came from
+  struct Hooked
+  {
+    BinaryTraceHelper *helper;
+    uint32_t nodeId;
+    uint32_t deviceId;
+    uint8_t source;
+  };
+
+  void
+  Hook (std::string path, Ptr<NetDevice> nd, uint8_t source)
+  {
+    Hooked *hooked = new Hooked;
+    hooked->helper = this;
+    hooked->nodeId = nd->GetNode ()->GetId ();
+    hooked->deviceId = nd->GetIfIndex ();
+    hooked->source = source;
+    m_hooks.push_back (hooked);
+    Config::ConnectWithoutContext (path, MakeBoundCallback (&BinaryTraceHelper::Sink, hooked));
+  }
+
+  static void
+  Sink (Hooked *hooked, Ptr<const Packet> p)
+  {
+    BinaryTraceHelper *helper = hooked->helper;
+    if (helper->m_file == 0 || !helper->m_filter.Matches (p, PcapHelper::DLT_PPP))
+      {
+        return;
+      }
+    BinaryTraceRecord record;
+    record.timeNs = Simulator::Now ().GetNanoSeconds ();
+    record.nodeId = hooked->nodeId;
+    record.deviceId = hooked->deviceId;
+    record.packetSize = p->GetSize ();
+    record.source = hooked->source;
+    record.reserved = 0;
+    record.capturedSize = std::min (record.packetSize, helper->m_snapLen);
+    p->CopyData (record.data, record.capturedSize);
+    std::memset (record.data + record.capturedSize, 0, BinaryTraceRecord::SNAP_LEN - record.capturedSize);
+    helper->Write (&record, sizeof (record));
+  }
+
+  // Keeps the first error; nothing more is written after it.
+  void
+  Write (const void *data, size_t size)
+  {
+    if (m_error.empty () && std::fwrite (data, size, 1, m_file) != 1)
+      {
+        m_error = std::strerror (errno);
+      }
+  }
+
+  std::FILE *m_file;
+  std::string m_filename;
+  std::string m_error;
+  std::vector<char> m_buffer;
+  uint32_t m_snapLen;
+  PacketFilter m_filter;
+  std::vector<Hooked *> m_hooks;
+};
+
+/**
+ * Read only, memory mapped view of a binary trace file.
+ */
+class BinaryTraceReader
+{
+public:
+  BinaryTraceReader (std::string filename)
+    : m_base (0),
+      m_size (0)
+  {
+    int fd = open (filename.c_str (), O_RDONLY);
+    NS_ABORT_MSG_IF (fd < 0, "Unable to open " << filename << ": " << std::strerror (errno));
+    struct stat st;
+    NS_ABORT_MSG_IF (fstat (fd, &st) != 0, "Unable to stat " << filename);
+    m_size = st.st_size;
+    NS_ABORT_MSG_IF (m_size < sizeof (BinaryTraceFileHeader), filename << " is not a binary trace");
+    void *base = mmap (0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    NS_ABORT_MSG_IF (base == MAP_FAILED, "Unable to map " << filename << ": " << std::strerror (errno));
+    m_base = static_cast<const uint8_t *> (base);
+
+    const BinaryTraceFileHeader *header = GetHeader ();
+    NS_ABORT_MSG_IF (std::memcmp (header->magic, BINARY_TRACE_MAGIC, sizeof (header->magic)) != 0,
+                     filename << " is not a binary trace");
+    NS_ABORT_MSG_IF (header->version != BINARY_TRACE_VERSION
+                     || header->recordSize != sizeof (BinaryTraceRecord),
+                     filename << " was written by an incompatible version");
+  }
+
+  ~BinaryTraceReader ()
+  {
+    munmap (const_cast<uint8_t *> (m_base), m_size);
+  }
+
+  const BinaryTraceFileHeader *
+  GetHeader (void) const
+  {
+    return reinterpret_cast<const BinaryTraceFileHeader *> (m_base);
+  }
+
+  /// Number of complete records in the file
+  uint64_t
+  GetN (void) const
+  {
+    return (m_size - sizeof (BinaryTraceFileHeader)) / sizeof (BinaryTraceRecord);
+  }
+
+  const BinaryTraceRecord &
+  Get (uint64_t i) const
+  {
+    return reinterpret_cast<const BinaryTraceRecord *> (m_base + sizeof (BinaryTraceFileHeader))[i];
+  }
+
+private:
+  const uint8_t *m_base;
+  size_t m_size;
+};
+
+} // namespace ns3
+
+#endif /* BINARY_TRACE_HELPER_H */
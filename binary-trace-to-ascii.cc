@@ -0,0 +1,145 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Turns a trace written by BinaryTraceHelper back into the lines
+// PointToPointHelper::EnableAsciiAll would have written, e.g.
+//
+//   ./waf --run "binary-trace-to-ascii --input=myfirst.btr --output=myfirst.tr"
+//
+// Headers are decoded from the bytes kept in each record (PPP, IPv4 and,
+// in the first fragment of a datagram, UDP); everything after them is
+// printed as the payload.  Fragments therefore show a plain payload size
+// rather than the "Fragment [a:b]" form of packet metadata, which the
+// record does not keep.
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+
+#include "binary-trace-helper.h"
+
+#include <fstream>
+#include <iostream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BinaryTraceToAscii");
+
+static const char *
+GetEvent (uint8_t source)
+{
+  switch (source)
+    {
+    case BinaryTraceRecord::ENQUEUE:
+      return "+";
+    case BinaryTraceRecord::DEQUEUE:
+      return "-";
+    case BinaryTraceRecord::MAC_RX:
+      return "r";
+    default:
+      return "d";
+    }
+}
+
+static const char *
+GetTraceName (uint8_t source)
+{
+  switch (source)
+    {
+    case BinaryTraceRecord::ENQUEUE:
+      return "TxQueue/Enqueue";
+    case BinaryTraceRecord::DEQUEUE:
+      return "TxQueue/Dequeue";
+    case BinaryTraceRecord::DROP:
+      return "TxQueue/Drop";
+    case BinaryTraceRecord::MAC_RX:
+      return "MacRx";
+    default:
+      return "PhyRxDrop";
+    }
+}
+
+static void
+PrintPacket (std::ostream &os, const BinaryTraceRecord &record)
+{
+  Ptr<Packet> p = Create<Packet> (record.data, record.capturedSize);
+  uint32_t remaining = record.packetSize;
+
+  PppHeader ppp;
+  if (remaining >= ppp.GetSerializedSize () && p->GetSize () >= ppp.GetSerializedSize ())
+    {
+      p->RemoveHeader (ppp);
+      remaining -= ppp.GetSerializedSize ();
+      os << "ns3::PppHeader (";
+      ppp.Print (os);
+      os << ") ";
+
+      Ipv4Header ip;
+      if (ppp.GetProtocol () == 0x0021 && p->GetSize () >= 20)
+        {
+          p->RemoveHeader (ip);
+          remaining -= ip.GetSerializedSize ();
+          os << "ns3::Ipv4Header (";
+          ip.Print (os);
+          os << ") ";
+
+          UdpHeader udp;
+          if (ip.GetProtocol () == UdpL4Protocol::PROT_NUMBER && ip.GetFragmentOffset () == 0
+              && p->GetSize () >= udp.GetSerializedSize ())
+            {
+              p->RemoveHeader (udp);
+              remaining -= udp.GetSerializedSize ();
+              os << "ns3::UdpHeader (";
+              udp.Print (os);
+              os << ") ";
+            }
+        }
+    }
+  os << "Payload (size=" << remaining << ")";
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "myfirst.btr";
+  std::string output = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Binary trace to read", input);
+  cmd.AddValue ("output", "ASCII trace to write (standard output if empty)", output);
+  cmd.Parse (argc, argv);
+
+  std::ofstream file;
+  if (!output.empty ())
+    {
+      file.open (output.c_str ());
+      NS_ABORT_MSG_UNLESS (file, "Unable to open " << output);
+    }
+  std::ostream &os = output.empty () ? std::cout : file;
+
+  BinaryTraceReader reader (input);
+  for (uint64_t i = 0; i < reader.GetN (); ++i)
+    {
+      const BinaryTraceRecord &record = reader.Get (i);
+      os << GetEvent (record.source) << " " << NanoSeconds (record.timeNs).GetSeconds ()
+         << " /NodeList/" << record.nodeId << "/DeviceList/" << record.deviceId
+         << "/$ns3::PointToPointNetDevice/" << GetTraceName (record.source) << " ";
+      PrintPacket (os, record);
+      os << "\n";
+    }
+  return 0;
+}
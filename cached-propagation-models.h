@@ -0,0 +1,348 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CACHED_PROPAGATION_MODELS_H
+#define CACHED_PROPAGATION_MODELS_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * A small index of a mobility model for StaticPairCache, aggregated to it.
+ *
+ * Indexes are handed out densely over the whole process, so that every
+ * cache can use them as matrix coordinates.  The generation goes up on
+ * every course change of the model; being part of the model's aggregate,
+ * the object listening to CourseChange lives exactly as long as the model.
+ */
+class PairCacheIndex : public Object
+{
+public:
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::PairCacheIndex")
+      .SetParent<Object> ()
+    ;
+    return tid;
+  }
+
+  /**
+   * \returns the index of model, aggregating one to it first if need be
+   */
+  static Ptr<PairCacheIndex>
+  Get (Ptr<MobilityModel> model)
+  {
+    Ptr<PairCacheIndex> index = model->GetObject<PairCacheIndex> ();
+    if (index == 0)
+      {
+        index = CreateObject<PairCacheIndex> ();
+        index->m_index = GetCount ()++;
+        index->m_generation = 0;
+        index->m_static = IsStatic (model);
+        model->AggregateObject (index);
+        model->TraceConnectWithoutContext ("CourseChange",
+                                           MakeCallback (&PairCacheIndex::CourseChanged, PeekPointer (index)));
+      }
+    return index;
+  }
+
+  uint32_t
+  GetIndex (void) const
+  {
+    return m_index;
+  }
+
+  uint32_t
+  GetGeneration (void) const
+  {
+    return m_generation;
+  }
+
+  /// Whether the model's velocity is zero, i.e. its position only changes by a course change
+  bool
+  IsStatic (void) const
+  {
+    return m_static;
+  }
+
+private:
+  static uint32_t &
+  GetCount (void)
+  {
+    static uint32_t count = 0;
+    return count;
+  }
+
+  static bool
+  IsStatic (Ptr<const MobilityModel> model)
+  {
+    Vector v = model->GetVelocity ();
+    return v.x == 0.0 && v.y == 0.0 && v.z == 0.0;
+  }
+
+  void
+  CourseChanged (Ptr<const MobilityModel> model)
+  {
+    ++m_generation;
+    m_static = IsStatic (model);
+  }
+
+  uint32_t m_index;
+  uint32_t m_generation;
+  bool m_static;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (PairCacheIndex);
+
+/**
+ * Dense matrix of per (transmitter, receiver) values, kept only for pairs
+ * of mobility models that are standing still.
+ *
+ * Rows and columns are the PairCacheIndex of the models.  An entry holds
+ * the course change generations of both models when it was stored, and
+ * only counts while they are unchanged, so a course change invalidates
+ * the pairs of a model without the cache listening to it.
+ */
+template <typename T>
+class StaticPairCache
+{
+public:
+  StaticPairCache ()
+    : m_size (0)
+  {
+  }
+
+  /**
+   * \returns the cached entry for (a, b), or 0 if there is none
+   */
+  T *
+  Find (Ptr<MobilityModel> a, Ptr<MobilityModel> b)
+  {
+    Ptr<PairCacheIndex> ia = PairCacheIndex::Get (a);
+    Ptr<PairCacheIndex> ib = PairCacheIndex::Get (b);
+    if (ia->GetIndex () >= m_size || ib->GetIndex () >= m_size)
+      {
+        return 0;
+      }
+    Cell &cell = m_cells[ia->GetIndex () * m_size + ib->GetIndex ()];
+    if (cell.valid && cell.generationA == ia->GetGeneration () && cell.generationB == ib->GetGeneration ())
+      {
+        return &cell.value;
+      }
+    return 0;
+  }
+
+  /**
+   * Remembers value for (a, b) if both of them are static.
+   */
+  void
+  Store (Ptr<MobilityModel> a, Ptr<MobilityModel> b, const T &value)
+  {
+    Ptr<PairCacheIndex> ia = PairCacheIndex::Get (a);
+    Ptr<PairCacheIndex> ib = PairCacheIndex::Get (b);
+    if (!ia->IsStatic () || !ib->IsStatic ())
+      {
+        return;
+      }
+    uint32_t needed = std::max (ia->GetIndex (), ib->GetIndex ()) + 1;
+    if (needed > m_size)
+      {
+        Grow (std::max (needed, m_size == 0 ? 8 : 2 * m_size));
+      }
+    Cell &cell = m_cells[ia->GetIndex () * m_size + ib->GetIndex ()];
+    cell.value = value;
+    cell.generationA = ia->GetGeneration ();
+    cell.generationB = ib->GetGeneration ();
+    cell.valid = true;
+  }
+
+private:
+  struct Cell
+  {
+    Cell ()
+      : generationA (0),
+        generationB (0),
+        valid (false)
+    {
+    }
+
+    T value;
+    uint32_t generationA;
+    uint32_t generationB;
+    bool valid;
+  };
+
+  void
+  Grow (uint32_t size)
+  {
+    std::vector<Cell> cells (size * size);
+    for (uint32_t i = 0; i < m_size; ++i)
+      {
+        for (uint32_t j = 0; j < m_size; ++j)
+          {
+            cells[i * size + j] = m_cells[i * m_size + j];
+          }
+      }
+    m_cells.swap (cells);
+    m_size = size;
+  }
+
+  std::vector<Cell> m_cells;
+  uint32_t m_size;
+};
+
+/**
+ * Propagation loss model that remembers the result of the wrapped model
+ * for pairs of nodes that are not moving, e.g. nodes using
+ * ConstantPositionMobilityModel.
+ *
+ * The result is kept together with the transmit power it was computed for,
+ * so a cache hit returns exactly what the wrapped model returned.  The
+ * wrapped model must be deterministic (no fading).
+ */
+class CachedPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CachedPropagationLossModel")
+      .SetParent<PropagationLossModel> ()
+      .AddConstructor<CachedPropagationLossModel> ()
+      .AddAttribute ("Inner",
+                     "The deterministic propagation loss model whose results are cached "
+                     "(a LogDistancePropagationLossModel if not set).",
+                     PointerValue (),
+                     MakePointerAccessor (&CachedPropagationLossModel::m_inner),
+                     MakePointerChecker<PropagationLossModel> ())
+    ;
+    return tid;
+  }
+
+private:
+  struct Entry
+  {
+    double txPowerDbm;
+    double rxPowerDbm;
+  };
+
+  virtual double
+  DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+  {
+    CachedPropagationLossModel *self = const_cast<CachedPropagationLossModel *> (this);
+    Entry *entry = self->m_cache.Find (a, b);
+    if (entry != 0 && entry->txPowerDbm == txPowerDbm)
+      {
+        return entry->rxPowerDbm;
+      }
+    Entry computed;
+    computed.txPowerDbm = txPowerDbm;
+    computed.rxPowerDbm = self->GetInner ()->CalcRxPower (txPowerDbm, a, b);
+    self->m_cache.Store (a, b, computed);
+    return computed.rxPowerDbm;
+  }
+
+  virtual int64_t
+  DoAssignStreams (int64_t stream)
+  {
+    return GetInner ()->AssignStreams (stream);
+  }
+
+  Ptr<PropagationLossModel>
+  GetInner (void)
+  {
+    if (m_inner == 0)
+      {
+        m_inner = CreateObject<LogDistancePropagationLossModel> ();
+      }
+    return m_inner;
+  }
+
+  Ptr<PropagationLossModel> m_inner;
+  StaticPairCache<Entry> m_cache;
+};
+
+/**
+ * Propagation delay model that remembers the delay computed by the wrapped
+ * model for pairs of nodes that are not moving.
+ */
+class CachedPropagationDelayModel : public PropagationDelayModel
+{
+public:
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CachedPropagationDelayModel")
+      .SetParent<PropagationDelayModel> ()
+      .AddConstructor<CachedPropagationDelayModel> ()
+      .AddAttribute ("Inner",
+                     "The deterministic propagation delay model whose results are cached "
+                     "(a ConstantSpeedPropagationDelayModel if not set).",
+                     PointerValue (),
+                     MakePointerAccessor (&CachedPropagationDelayModel::m_inner),
+                     MakePointerChecker<PropagationDelayModel> ())
+    ;
+    return tid;
+  }
+
+  virtual Time
+  GetDelay (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+  {
+    CachedPropagationDelayModel *self = const_cast<CachedPropagationDelayModel *> (this);
+    Time *delay = self->m_cache.Find (a, b);
+    if (delay != 0)
+      {
+        return *delay;
+      }
+    Time computed = self->GetInner ()->GetDelay (a, b);
+    self->m_cache.Store (a, b, computed);
+    return computed;
+  }
+
+private:
+  virtual int64_t
+  DoAssignStreams (int64_t stream)
+  {
+    return GetInner ()->AssignStreams (stream);
+  }
+
+  Ptr<PropagationDelayModel>
+  GetInner (void)
+  {
+    if (m_inner == 0)
+      {
+        m_inner = CreateObject<ConstantSpeedPropagationDelayModel> ();
+      }
+    return m_inner;
+  }
+
+  Ptr<PropagationDelayModel> m_inner;
+  StaticPairCache<Time> m_cache;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (CachedPropagationLossModel);
+NS_OBJECT_ENSURE_REGISTERED (CachedPropagationDelayModel);
+
+} // namespace ns3
+
+#endif /* CACHED_PROPAGATION_MODELS_H */
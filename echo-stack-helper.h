@@ -0,0 +1,153 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ECHO_STACK_HELPER_H
+#define ECHO_STACK_HELPER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * Installs only the part of the internet stack a UDP echo scenario uses:
+ * IPv4 with ARP and ICMP, UDP and the traffic control layer IPv4 sends
+ * through.  Unlike InternetStackHelper it aggregates no IPv6 protocols, no
+ * TCP and no packet sockets.  ICMP stays because IPv4 reports TTL expiry
+ * and unreachable ports through it; TCP can be added back with
+ * SetTcpEnabled when a scenario needs it.
+ *
+ * Routing is set up as by InternetStackHelper: Ipv4StaticRouting plus
+ * Ipv4GlobalRouting in an Ipv4ListRouting, unless SetRoutingHelper is
+ * called.
+ */
+class EchoStackHelper
+{
+public:
+  EchoStackHelper ()
+    : m_routing (0),
+      m_tcp (false)
+  {
+    Ipv4StaticRoutingHelper staticRouting;
+    Ipv4GlobalRoutingHelper globalRouting;
+    Ipv4ListRoutingHelper listRouting;
+    listRouting.Add (staticRouting, 0);
+    listRouting.Add (globalRouting, -10);
+    SetRoutingHelper (listRouting);
+  }
+
+  ~EchoStackHelper ()
+  {
+    delete m_routing;
+  }
+
+  void
+  SetRoutingHelper (const Ipv4RoutingHelper &routing)
+  {
+    delete m_routing;
+    m_routing = routing.Copy ();
+  }
+
+  void
+  SetTcpEnabled (bool enable)
+  {
+    m_tcp = enable;
+  }
+
+  void
+  Install (Ptr<Node> node)
+  {
+    NS_ABORT_MSG_IF (node->GetObject<Ipv4> () != 0,
+                     "EchoStackHelper::Install (): node " << node->GetId () << " already has a stack");
+    Aggregate (node, "ns3::ArpL3Protocol");
+    Aggregate (node, "ns3::Ipv4L3Protocol");
+    Aggregate (node, "ns3::Icmpv4L4Protocol");
+    node->GetObject<Ipv4> ()->SetRoutingProtocol (m_routing->Create (node));
+    Aggregate (node, "ns3::TrafficControlLayer");
+    Aggregate (node, "ns3::UdpL4Protocol");
+    if (m_tcp)
+      {
+        Aggregate (node, "ns3::TcpL4Protocol");
+      }
+  }
+
+  void
+  Install (NodeContainer c)
+  {
+    for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+      {
+        Install (*i);
+      }
+  }
+
+  /**
+   * Objects aggregated to node, the node itself included.
+   */
+  static uint32_t
+  CountObjects (Ptr<Node> node)
+  {
+    uint32_t n = 0;
+    Object::AggregateIterator i = node->GetAggregateIterator ();
+    while (i.HasNext ())
+      {
+        i.Next ();
+        ++n;
+      }
+    return n;
+  }
+
+  /**
+   * Prints the per node cost of the stack on nodes: the objects
+   * aggregated to each node and bytes, the heap bytes its installation
+   * allocated (AllocStats::Get before and after Install), spread over the
+   * nodes.  Run once with each stack to compare them.
+   */
+  static void
+  PrintFootprint (std::ostream &os, std::string name, NodeContainer nodes, uint64_t bytes)
+  {
+    uint64_t objects = 0;
+    for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+      {
+        objects += CountObjects (*i);
+      }
+    uint32_t n = std::max (1u, nodes.GetN ());
+    os << name << " stack: " << nodes.GetN () << " nodes, "
+       << double (objects) / n << " objects per node, "
+       << bytes / n << " bytes per node" << std::endl;
+  }
+
+private:
+  static void
+  Aggregate (Ptr<Node> node, std::string typeName)
+  {
+    ObjectFactory factory;
+    factory.SetTypeId (typeName);
+    node->AggregateObject (factory.Create<Object> ());
+  }
+
+  Ipv4RoutingHelper *m_routing;
+  bool m_tcp;
+};
+
+} // namespace ns3
+
+#endif /* ECHO_STACK_HELPER_H */
@@ -20,6 +20,13 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 
+#include "flow-stats-collector.h"
+#include "ladder-scheduler.h"
+#include "recording-scheduler.h"
+#include "profiling-scheduler.h"
+#include "scenario-bench.h"
+#include "udp-echo-rtt-client.h"
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("FirstScriptExample");
@@ -27,8 +34,42 @@ NS_LOG_COMPONENT_DEFINE ("FirstScriptExample");
 int
 main (int argc, char *argv[])
 {
-  LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
-  LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
+  bool verbose = true;
+  bool tracing = false;
+  uint32_t nPackets = 0;
+  std::string recordEvents = "";
+  std::string benchOutput = "";
+  std::string profileEvents = "";
+  std::string flowStats = "";
+  bool rtt = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+  cmd.AddValue ("tracing", "Write pcap files of every link", tracing);
+  cmd.AddValue ("nPackets", "Packets sent by each echo client (0 = 100 and 50)", nPackets);
+  cmd.AddValue ("recordEvents", "Log every event queue operation to this file, for scheduler-benchmark", recordEvents);
+  cmd.AddValue ("benchOutput", "Append wall time, events, memory and allocations of the run to this file", benchOutput);
+  cmd.AddValue ("profileEvents", "Write the wall time of each kind of event to this file, as folded stacks for flamegraph.pl", profileEvents);
+  cmd.AddValue ("flowStats", "Write per-flow packet, delay and jitter counters to this file (CSV, or JSON if it ends in .json)", flowStats);
+  cmd.AddValue ("rtt", "Echo clients measure round trip times into histograms, instead of logging each packet", rtt);
+  cmd.Parse (argc, argv);
+
+  if (!recordEvents.empty ())
+    {
+      RecordingScheduler::Enable (recordEvents);
+    }
+  if (!profileEvents.empty ())
+    {
+      ProfilingScheduler::Enable (profileEvents);
+    }
+  ScenarioBench bench ("ex2", benchOutput, argc, argv);
+  bench.SetPackets (nPackets);
+
+  if (verbose)
+    {
+      LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
+      LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
+    }
 
   NodeContainer nodes;
   nodes.Create (4);
@@ -66,7 +107,7 @@ main (int argc, char *argv[])
   serverApps.Start (Seconds (1.0));
   serverApps.Stop (Seconds (15.0));
 
-  UdpEchoClientHelper echoClient (interfaces.GetAddress (1), 9);
+  UdpEchoRttClientHelper echoClient (interfaces.GetAddress (1), 9, rtt);
   echoClient.SetAttribute ("MaxPackets", UintegerValue (100));
   echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
   echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
@@ -82,7 +123,7 @@ main (int argc, char *argv[])
   serverApps2.Start (Seconds (1.0));
   serverApps2.Stop (Seconds (15.0));
 
-  UdpEchoClientHelper echoClient2 (interface2.GetAddress (1), 9);
+  UdpEchoRttClientHelper echoClient2 (interface2.GetAddress (1), 9, rtt);
   echoClient2.SetAttribute ("MaxPackets", UintegerValue (50));
   echoClient2.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
   echoClient2.SetAttribute ("PacketSize", UintegerValue (1024));
@@ -91,8 +132,27 @@ main (int argc, char *argv[])
   clientApps2.Start (Seconds (4.0));
   clientApps2.Stop (Seconds (14.0));
 
+  if (tracing)
+    {
+      // Covers the links of pointToPoint2 as well
+      pointToPoint.EnablePcapAll ("ex2");
+    }
  
+  FlowStatsCollector flows;
+  if (!flowStats.empty ())
+    {
+      flows.Install ();
+    }
+
   Simulator::Run ();
+  if (rtt)
+    {
+      UdpEchoRttClientHelper::PrintAll (std::cout);
+    }
+  if (!flowStats.empty ())
+    {
+      flows.Write (flowStats);
+    }
   Simulator::Destroy ();
   return 0;
 }
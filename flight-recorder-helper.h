@@ -0,0 +1,302 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLIGHT_RECORDER_HELPER_H
+#define FLIGHT_RECORDER_HELPER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/csma-module.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * The last packets seen by one device, kept in storage allocated up front.
+ */
+class FlightRecorderRing
+{
+public:
+  FlightRecorderRing (Ptr<NetDevice> device, uint32_t dataLinkType, uint32_t capacity, uint32_t snapLen)
+    : m_device (device),
+      m_dataLinkType (dataLinkType),
+      m_snapLen (snapLen),
+      m_slots (capacity),
+      m_data (capacity * snapLen),
+      m_next (0)
+  {
+  }
+
+  void
+  Record (Ptr<const Packet> p)
+  {
+    Slot &slot = m_slots[m_next % m_slots.size ()];
+    slot.timeUs = Simulator::Now ().GetMicroSeconds ();
+    slot.origLen = p->GetSize ();
+    slot.inclLen = p->CopyData (&m_data[(m_next % m_slots.size ()) * m_snapLen], m_snapLen);
+    ++m_next;
+  }
+
+  /**
+   * Writes the recorded packets no older than since (in microseconds),
+   * oldest first, as a pcap file.
+   */
+  void
+  Dump (std::string filename, int64_t since) const
+  {
+    std::ofstream file (filename.c_str (), std::ios::out | std::ios::binary);
+    NS_ABORT_MSG_UNLESS (file, "Unable to open " << filename);
+    FileHeader header = { 0xa1b2c3d4, 2, 4, 0, 0, m_snapLen, m_dataLinkType };
+    file.write (reinterpret_cast<const char *> (&header), sizeof (header));
+
+    uint64_t count = std::min<uint64_t> (m_next, m_slots.size ());
+    for (uint64_t i = m_next - count; i < m_next; ++i)
+      {
+        const Slot &slot = m_slots[i % m_slots.size ()];
+        if (slot.timeUs < since)
+          {
+            continue;
+          }
+        uint32_t recordHeader[4] = { uint32_t (slot.timeUs / 1000000), uint32_t (slot.timeUs % 1000000),
+                                     slot.inclLen, slot.origLen };
+        file.write (reinterpret_cast<const char *> (recordHeader), sizeof (recordHeader));
+        file.write (reinterpret_cast<const char *> (&m_data[(i % m_slots.size ()) * m_snapLen]), slot.inclLen);
+      }
+  }
+
+  Ptr<NetDevice>
+  GetDevice (void) const
+  {
+    return m_device;
+  }
+
+private:
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    int32_t zone;
+    uint32_t sigFigs;
+    uint32_t snapLen;
+    uint32_t network;
+  };
+
+  struct Slot
+  {
+    int64_t timeUs;
+    uint32_t origLen;
+    uint32_t inclLen;
+  };
+
+  Ptr<NetDevice> m_device;
+  uint32_t m_dataLinkType;
+  uint32_t m_snapLen;
+  std::vector<Slot> m_slots;
+  std::vector<uint8_t> m_data;
+  // Packets recorded so far; the next slot is this modulo the capacity.
+  uint64_t m_next;
+};
+
+/**
+ * Flight-recorder capture: every enabled device keeps its last packets in
+ * memory, and pcap files are only written when a trigger fires.
+ *
+ * Each dump writes one file per device, named like EnablePcap would with
+ * "<prefix>-<dump number>" as the prefix, holding the last maxPackets
+ * packets of that device (only those of the last window of simulation time
+ * if a window is set).  Triggers are a call to Trigger, any trace source
+ * passed to TriggerOnTrace, a check scheduled with TriggerAt or a predicate
+ * on captured packets.
+ */
+class FlightRecorderHelper
+{
+public:
+  /**
+   * \param maxPackets packets kept per device
+   * \param window if positive, only packets this recent are dumped
+   * \param snapLen bytes kept of each packet
+   */
+  FlightRecorderHelper (uint32_t maxPackets = 1000, Time window = Seconds (0), uint32_t snapLen = 128)
+    : m_maxPackets (maxPackets),
+      m_window (window),
+      m_snapLen (snapLen),
+      m_maxDumps (16),
+      m_dumps (0),
+      m_prefix ("flight-recorder")
+  {
+  }
+
+  ~FlightRecorderHelper ()
+  {
+    for (std::vector<FlightRecorderRing *>::iterator i = m_rings.begin (); i != m_rings.end (); ++i)
+      {
+        delete *i;
+      }
+  }
+
+  void
+  SetPrefix (std::string prefix)
+  {
+    m_prefix = prefix;
+  }
+
+  /**
+   * Triggers after this many dumps are ignored, so a persistent fault does
+   * not fill the disk.
+   */
+  void
+  SetMaxDumps (uint32_t maxDumps)
+  {
+    m_maxDumps = maxDumps;
+  }
+
+  void
+  Enable (Ptr<NetDevice> nd, bool promiscuous = false)
+  {
+    std::string traceName;
+    uint32_t dataLinkType;
+    if (nd->GetObject<PointToPointNetDevice> () != 0)
+      {
+        traceName = "PromiscSniffer";
+        dataLinkType = PcapHelper::DLT_PPP;
+      }
+    else if (nd->GetObject<CsmaNetDevice> () != 0)
+      {
+        traceName = promiscuous ? "PromiscSniffer" : "Sniffer";
+        dataLinkType = PcapHelper::DLT_EN10MB;
+      }
+    else
+      {
+        NS_FATAL_ERROR ("FlightRecorderHelper does not know how to capture on " << nd->GetInstanceTypeId ().GetName ());
+      }
+    FlightRecorderRing *ring = new FlightRecorderRing (nd, dataLinkType, m_maxPackets, m_snapLen);
+    m_rings.push_back (ring);
+    nd->TraceConnectWithoutContext (traceName, MakeBoundCallback (&FlightRecorderHelper::Sink, this, ring));
+  }
+
+  void
+  Enable (NetDeviceContainer d, bool promiscuous = false)
+  {
+    for (NetDeviceContainer::Iterator i = d.Begin (); i != d.End (); ++i)
+      {
+        Enable (*i, promiscuous);
+      }
+  }
+
+  /**
+   * Dumps every ring now.
+   */
+  void
+  Trigger (std::string reason)
+  {
+    if (m_dumps >= m_maxDumps)
+      {
+        return;
+      }
+    ++m_dumps;
+    std::ostringstream prefix;
+    prefix << m_prefix << "-" << m_dumps;
+    std::cout << "Flight recorder dump " << m_dumps << " at " << Simulator::Now ().GetSeconds ()
+              << "s (" << reason << ") to " << prefix.str () << "-*.pcap" << std::endl;
+
+    int64_t since = m_window.IsStrictlyPositive () ? (Simulator::Now () - m_window).GetMicroSeconds () : 0;
+    PcapHelper pcapHelper;
+    for (std::vector<FlightRecorderRing *>::iterator i = m_rings.begin (); i != m_rings.end (); ++i)
+      {
+        (*i)->Dump (pcapHelper.GetFilenameFromDevice (prefix.str (), (*i)->GetDevice ()), since);
+      }
+  }
+
+  /**
+   * Dumps whenever the packet trace source at path fires, e.g.
+   * "/NodeList/0/DeviceList/1/$ns3::PointToPointNetDevice/PhyRxDrop".
+   */
+  void
+  TriggerOnTrace (std::string path, std::string reason)
+  {
+    Config::ConnectWithoutContext (path, MakeBoundCallback (&FlightRecorderHelper::TraceTriggered, this, reason));
+  }
+
+  /**
+   * Dumps at time at (absolute) if check returns true then, e.g. to catch a
+   * reply that should have arrived by that time.
+   */
+  void
+  TriggerAt (Time at, Callback<bool> check, std::string reason)
+  {
+    Simulator::Schedule (at - Simulator::Now (), &FlightRecorderHelper::Check, this, check, reason);
+  }
+
+  /**
+   * Dumps (after recording it) whenever a captured packet satisfies
+   * predicate.
+   */
+  void
+  TriggerOnPacket (Callback<bool, Ptr<const Packet> > predicate, std::string reason)
+  {
+    m_predicates.push_back (std::make_pair (predicate, reason));
+  }
+
+private:
+  static void
+  Sink (FlightRecorderHelper *helper, FlightRecorderRing *ring, Ptr<const Packet> p)
+  {
+    ring->Record (p);
+    for (uint32_t i = 0; i < helper->m_predicates.size (); ++i)
+      {
+        if (helper->m_predicates[i].first (p))
+          {
+            helper->Trigger (helper->m_predicates[i].second);
+          }
+      }
+  }
+
+  static void
+  TraceTriggered (FlightRecorderHelper *helper, std::string reason, Ptr<const Packet> p)
+  {
+    helper->Trigger (reason);
+  }
+
+  void
+  Check (Callback<bool> check, std::string reason)
+  {
+    if (check ())
+      {
+        Trigger (reason);
+      }
+  }
+
+  uint32_t m_maxPackets;
+  Time m_window;
+  uint32_t m_snapLen;
+  uint32_t m_maxDumps;
+  uint32_t m_dumps;
+  std::string m_prefix;
+  std::vector<FlightRecorderRing *> m_rings;
+  std::vector<std::pair<Callback<bool, Ptr<const Packet> >, std::string> > m_predicates;
+};
+
+} // namespace ns3
+
+#endif /* FLIGHT_RECORDER_HELPER_H */
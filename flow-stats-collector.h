@@ -0,0 +1,492 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FLOW_STATS_COLLECTOR_H
+#define FLOW_STATS_COLLECTOR_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Per-flow packet, byte, delay and jitter counters for every IPv4 flow,
+ * written out once at the end of the run, as a replacement for enabling
+ * the echo application logs and reading them back.
+ *
+ * A flow is a (source, destination, protocol, source port, destination
+ * port) 5-tuple; ports are those of UDP and TCP, 0 otherwise.  Packets
+ * are counted when the IPv4 layer of their source sends them
+ * (SendOutgoing), when it delivers them at their destination
+ * (LocalDeliver) and when any IPv4 layer drops them (Drop).  Losses below
+ * IPv4, e.g. a full device queue, show up as packets sent but neither
+ * received nor dropped.  A broadcast flow counts a reception per receiver
+ * and a delay for the first one only.
+ *
+ * The send time of a packet lost below IPv4 never gets looked up again,
+ * so send times older than the maximum delay (SetMaxDelay, 10 s by
+ * default) are dropped whenever the table would otherwise have to grow.
+ * Such a packet is counted as lost; should it arrive after all, it is
+ * counted as received, without a delay.
+ *
+ * Flows live in an open-addressed table of cache-line aligned entries,
+ * and send times in a second one keyed by packet uid, so a packet costs a
+ * hash lookup and a few additions at each end.  The simulator runs the
+ * trace sinks on its own thread, so there is nothing to lock.
+ */
+class FlowStatsCollector
+{
+public:
+  FlowStatsCollector ()
+    : m_flows (AllocateFlows (64)),
+      m_capacity (64),
+      m_flowCount (0),
+      m_sentCount (0),
+      m_maxDelay (Seconds (10).GetTimeStep ())
+  {
+    m_sent.resize (256);
+  }
+
+  ~FlowStatsCollector ()
+  {
+    std::free (m_flows);
+  }
+
+  /**
+   * Packets not received maxDelay after they were sent are taken as lost.
+   */
+  void
+  SetMaxDelay (Time maxDelay)
+  {
+    m_maxDelay = maxDelay.GetTimeStep ();
+  }
+
+  /**
+   * Starts counting on every node with an IPv4 stack; call once the
+   * stacks are installed.
+   */
+  void
+  Install (void)
+  {
+    Config::ConnectWithoutContext ("/NodeList/*/$ns3::Ipv4L3Protocol/SendOutgoing",
+                                   MakeCallback (&FlowStatsCollector::Sent, this));
+    Config::ConnectWithoutContext ("/NodeList/*/$ns3::Ipv4L3Protocol/LocalDeliver",
+                                   MakeCallback (&FlowStatsCollector::Delivered, this));
+    Config::ConnectWithoutContext ("/NodeList/*/$ns3::Ipv4L3Protocol/Drop",
+                                   MakeCallback (&FlowStatsCollector::Dropped, this));
+  }
+
+  /**
+   * Writes the flows to filename, as JSON if it ends in .json and as CSV
+   * otherwise.
+   */
+  void
+  Write (std::string filename) const
+  {
+    std::ofstream out (filename.c_str ());
+    NS_ABORT_MSG_UNLESS (out, "Unable to open " << filename);
+    if (filename.size () >= 5 && filename.compare (filename.size () - 5, 5, ".json") == 0)
+      {
+        WriteJson (out);
+      }
+    else
+      {
+        WriteCsv (out);
+      }
+  }
+
+  void
+  WriteCsv (std::ostream &os) const
+  {
+    os << "source,sourcePort,destination,destinationPort,protocol,txPackets,rxPackets,lostPackets,"
+       << "droppedPackets,txBytes,rxBytes,meanDelayMs,meanJitterMs,throughputKbps" << std::endl;
+    std::vector<const Flow *> flows = GetSortedFlows ();
+    for (uint32_t i = 0; i < flows.size (); ++i)
+      {
+        const Flow &f = *flows[i];
+        os << Ipv4Address (f.source) << "," << f.sourcePort << ","
+           << Ipv4Address (f.destination) << "," << f.destinationPort << ","
+           << uint32_t (f.protocol) << "," << f.txPackets << "," << f.rxPackets << ","
+           << GetLost (f) << "," << f.droppedPackets << "," << f.txBytes << "," << f.rxBytes << ","
+           << GetMeanDelayMs (f) << "," << GetMeanJitterMs (f) << "," << GetThroughputKbps (f) << std::endl;
+      }
+  }
+
+  void
+  WriteJson (std::ostream &os) const
+  {
+    std::vector<const Flow *> flows = GetSortedFlows ();
+    os << "[";
+    for (uint32_t i = 0; i < flows.size (); ++i)
+      {
+        const Flow &f = *flows[i];
+        os << (i == 0 ? "\n" : ",\n")
+           << "  {\"source\":\"" << Ipv4Address (f.source) << "\",\"sourcePort\":" << f.sourcePort
+           << ",\"destination\":\"" << Ipv4Address (f.destination) << "\",\"destinationPort\":" << f.destinationPort
+           << ",\"protocol\":" << uint32_t (f.protocol)
+           << ",\"txPackets\":" << f.txPackets << ",\"rxPackets\":" << f.rxPackets
+           << ",\"lostPackets\":" << GetLost (f) << ",\"droppedPackets\":" << f.droppedPackets
+           << ",\"txBytes\":" << f.txBytes << ",\"rxBytes\":" << f.rxBytes
+           << ",\"meanDelayMs\":" << GetMeanDelayMs (f) << ",\"meanJitterMs\":" << GetMeanJitterMs (f)
+           << ",\"throughputKbps\":" << GetThroughputKbps (f) << "}";
+      }
+    os << "\n]" << std::endl;
+  }
+
+private:
+  // What every packet touches comes first, in the entry's first cache line.
+  struct Flow
+  {
+    uint32_t source;
+    uint32_t destination;
+    uint16_t sourcePort;
+    uint16_t destinationPort;
+    uint8_t protocol;
+    // False for a free slot
+    bool used;
+    uint32_t txPackets;
+    uint32_t rxPackets;
+    uint32_t droppedPackets;
+    // Packets whose delay is known
+    uint32_t delays;
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    // Time steps
+    int64_t delaySum;
+    int64_t jitterSum;
+    int64_t lastDelay;
+    int64_t firstTx;
+    int64_t lastRx;
+  } __attribute__ ((aligned (64)));
+
+  struct SentPacket
+  {
+    // Uid + 1, 0 for a free slot
+    uint64_t uid;
+    int64_t time;
+  };
+
+  static uint64_t
+  Mix (uint64_t x)
+  {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+  }
+
+  static Flow
+  GetKey (const Ipv4Header &header, Ptr<const Packet> p)
+  {
+    Flow key;
+    std::memset (&key, 0, sizeof (key));
+    key.source = header.GetSource ().Get ();
+    key.destination = header.GetDestination ().Get ();
+    key.protocol = header.GetProtocol ();
+    // The first four bytes of both UDP and TCP are the ports
+    if ((key.protocol == UdpL4Protocol::PROT_NUMBER || key.protocol == TcpL4Protocol::PROT_NUMBER)
+        && header.GetFragmentOffset () == 0 && p->GetSize () >= 4)
+      {
+        uint8_t ports[4];
+        p->CopyData (ports, 4);
+        key.sourcePort = (ports[0] << 8) | ports[1];
+        key.destinationPort = (ports[2] << 8) | ports[3];
+      }
+    return key;
+  }
+
+  static bool
+  SameFlow (const Flow &a, const Flow &b)
+  {
+    return a.source == b.source && a.destination == b.destination && a.protocol == b.protocol
+           && a.sourcePort == b.sourcePort && a.destinationPort == b.destinationPort;
+  }
+
+  static uint64_t
+  Hash (const Flow &key)
+  {
+    uint64_t addresses = (uint64_t (key.source) << 32) | key.destination;
+    uint64_t rest = (uint64_t (key.sourcePort) << 24) | (uint64_t (key.destinationPort) << 8) | key.protocol;
+    return Mix (addresses ^ Mix (rest));
+  }
+
+  static Flow *
+  AllocateFlows (uint32_t n)
+  {
+    void *flows;
+    NS_ABORT_MSG_IF (posix_memalign (&flows, 64, n * sizeof (Flow)) != 0, "FlowStatsCollector: out of memory");
+    std::memset (flows, 0, n * sizeof (Flow));
+    return static_cast<Flow *> (flows);
+  }
+
+  Flow &
+  Lookup (const Flow &key)
+  {
+    uint64_t mask = m_capacity - 1;
+    for (uint64_t i = Hash (key) & mask; ; i = (i + 1) & mask)
+      {
+        Flow &f = m_flows[i];
+        if (f.used && SameFlow (f, key))
+          {
+            return f;
+          }
+        if (!f.used)
+          {
+            if (2 * (m_flowCount + 1) > m_capacity)
+              {
+                GrowFlows ();
+                return Lookup (key);
+              }
+            f = key;
+            f.used = true;
+            f.firstTx = -1;
+            ++m_flowCount;
+            return f;
+          }
+      }
+  }
+
+  void
+  GrowFlows (void)
+  {
+    Flow *old = m_flows;
+    uint32_t oldCapacity = m_capacity;
+    m_capacity *= 2;
+    m_flows = AllocateFlows (m_capacity);
+    uint64_t mask = m_capacity - 1;
+    for (uint32_t j = 0; j < oldCapacity; ++j)
+      {
+        if (old[j].used)
+          {
+            uint64_t i = Hash (old[j]) & mask;
+            while (m_flows[i].used)
+              {
+                i = (i + 1) & mask;
+              }
+            m_flows[i] = old[j];
+          }
+      }
+    std::free (old);
+  }
+
+  void
+  RememberSent (uint64_t uid, int64_t time)
+  {
+    if (2 * (m_sentCount + 1) > m_sent.size ())
+      {
+        // Drop the send times of the packets that must have been lost, and
+        // only grow if the rest would still fill more than a quarter, so
+        // that a table kept near full does not sweep on every packet.
+        int64_t expired = time - m_maxDelay;
+        uint32_t kept = 0;
+        for (std::vector<SentPacket>::const_iterator s = m_sent.begin (); s != m_sent.end (); ++s)
+          {
+            kept += s->uid != 0 && s->time >= expired;
+          }
+        std::vector<SentPacket> old (4 * (kept + 1) > m_sent.size () ? m_sent.size () * 2 : m_sent.size ());
+        old.swap (m_sent);
+        m_sentCount = 0;
+        for (std::vector<SentPacket>::const_iterator s = old.begin (); s != old.end (); ++s)
+          {
+            if (s->uid != 0 && s->time >= expired)
+              {
+                RememberSent (s->uid - 1, s->time);
+              }
+          }
+      }
+    uint64_t mask = m_sent.size () - 1;
+    uint64_t i = Mix (uid) & mask;
+    while (m_sent[i].uid != 0 && m_sent[i].uid != uid + 1)
+      {
+        i = (i + 1) & mask;
+      }
+    m_sentCount += m_sent[i].uid == 0;
+    m_sent[i].uid = uid + 1;
+    m_sent[i].time = time;
+  }
+
+  /**
+   * Removes the send time of uid, if known, into time.
+   */
+  bool
+  ForgetSent (uint64_t uid, int64_t &time)
+  {
+    uint64_t mask = m_sent.size () - 1;
+    uint64_t i = Mix (uid) & mask;
+    while (m_sent[i].uid != uid + 1)
+      {
+        if (m_sent[i].uid == 0)
+          {
+            return false;
+          }
+        i = (i + 1) & mask;
+      }
+    time = m_sent[i].time;
+    // Backward shift deletion: pull later entries of the probe run into
+    // the hole, so lookups never need tombstones.
+    uint64_t hole = i;
+    for (uint64_t j = (i + 1) & mask; m_sent[j].uid != 0; j = (j + 1) & mask)
+      {
+        uint64_t home = Mix (m_sent[j].uid - 1) & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask))
+          {
+            m_sent[hole] = m_sent[j];
+            hole = j;
+          }
+      }
+    m_sent[hole].uid = 0;
+    --m_sentCount;
+    return true;
+  }
+
+  void
+  Sent (const Ipv4Header &header, Ptr<const Packet> p, uint32_t interface)
+  {
+    int64_t now = Simulator::Now ().GetTimeStep ();
+    Flow &f = Lookup (GetKey (header, p));
+    ++f.txPackets;
+    f.txBytes += p->GetSize () + header.GetSerializedSize ();
+    if (f.firstTx < 0)
+      {
+        f.firstTx = now;
+      }
+    RememberSent (p->GetUid (), now);
+  }
+
+  void
+  Delivered (const Ipv4Header &header, Ptr<const Packet> p, uint32_t interface)
+  {
+    int64_t now = Simulator::Now ().GetTimeStep ();
+    Flow &f = Lookup (GetKey (header, p));
+    ++f.rxPackets;
+    f.rxBytes += p->GetSize () + header.GetSerializedSize ();
+    f.lastRx = now;
+    int64_t sent;
+    if (ForgetSent (p->GetUid (), sent))
+      {
+        int64_t delay = now - sent;
+        f.delaySum += delay;
+        if (f.delays != 0)
+          {
+            f.jitterSum += std::abs (delay - f.lastDelay);
+          }
+        f.lastDelay = delay;
+        ++f.delays;
+      }
+  }
+
+  void
+  Dropped (const Ipv4Header &header, Ptr<const Packet> p, Ipv4L3Protocol::DropReason reason,
+           Ptr<Ipv4> ipv4, uint32_t interface)
+  {
+    ++Lookup (GetKey (header, p)).droppedPackets;
+    int64_t sent;
+    ForgetSent (p->GetUid (), sent);
+  }
+
+  std::vector<const Flow *>
+  GetSortedFlows (void) const
+  {
+    std::vector<const Flow *> flows;
+    for (uint32_t i = 0; i < m_capacity; ++i)
+      {
+        if (m_flows[i].used)
+          {
+            flows.push_back (&m_flows[i]);
+          }
+      }
+    std::sort (flows.begin (), flows.end (), &FlowStatsCollector::KeyLess);
+    return flows;
+  }
+
+  static bool
+  KeyLess (const Flow *a, const Flow *b)
+  {
+    if (a->source != b->source)
+      {
+        return a->source < b->source;
+      }
+    if (a->destination != b->destination)
+      {
+        return a->destination < b->destination;
+      }
+    if (a->protocol != b->protocol)
+      {
+        return a->protocol < b->protocol;
+      }
+    if (a->sourcePort != b->sourcePort)
+      {
+        return a->sourcePort < b->sourcePort;
+      }
+    return a->destinationPort < b->destinationPort;
+  }
+
+  static uint32_t
+  GetLost (const Flow &f)
+  {
+    uint32_t accounted = f.rxPackets + f.droppedPackets;
+    return f.txPackets > accounted ? f.txPackets - accounted : 0;
+  }
+
+  static double
+  GetMeanDelayMs (const Flow &f)
+  {
+    return f.delays == 0 ? 0 : TimeStep (f.delaySum / f.delays).GetSeconds () * 1e3;
+  }
+
+  static double
+  GetMeanJitterMs (const Flow &f)
+  {
+    return f.delays < 2 ? 0 : TimeStep (f.jitterSum / (f.delays - 1)).GetSeconds () * 1e3;
+  }
+
+  static double
+  GetThroughputKbps (const Flow &f)
+  {
+    if (f.firstTx < 0 || f.lastRx <= f.firstTx)
+      {
+        return 0;
+      }
+    return f.rxBytes * 8 / TimeStep (f.lastRx - f.firstTx).GetSeconds () / 1e3;
+  }
+
+  FlowStatsCollector (const FlowStatsCollector &);
+  FlowStatsCollector &operator = (const FlowStatsCollector &);
+
+  Flow *m_flows;
+  uint32_t m_capacity;
+  uint32_t m_flowCount;
+  std::vector<SentPacket> m_sent;
+  uint32_t m_sentCount;
+  // Time steps
+  int64_t m_maxDelay;
+};
+
+} // namespace ns3
+
+#endif /* FLOW_STATS_COLLECTOR_H */
@@ -0,0 +1,172 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FORK_SWEEP_H
+#define FORK_SWEEP_H
+
+// Parameter sweeps over forked processes.
+//
+// The simulator is a process-wide singleton, so the only way to run several
+// points of a sweep at the same time is to run them in separate processes.
+// Forking also gives us copy-on-write snapshots for free: build and warm up
+// a scenario once, then fork one child per parameter value and let each of
+// them carry on from the same simulation state.
+//
+// Not built on its own; include it from the scratch program using it.
+
+#include "ns3/core-module.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+class ForkSweep
+{
+public:
+  /// Result reported for a job whose child did not exit cleanly
+  static const uint32_t FAILED = 0xffffffff;
+
+  /**
+   * \param maxJobs number of children allowed to run at the same time,
+   *        0 for one per online core
+   */
+  ForkSweep (uint32_t maxJobs = 0)
+    : m_maxJobs (maxJobs == 0 ? GetDefaultJobs () : maxJobs)
+  {
+  }
+
+  static uint32_t
+  GetDefaultJobs (void)
+  {
+    long nCores = sysconf (_SC_NPROCESSORS_ONLN);
+    return nCores > 0 ? nCores : 1;
+  }
+
+  /**
+   * Runs job (0) .. job (nJobs - 1), each in its own forked child.  Whatever
+   * state the calling process has (a built topology, a half-run simulation)
+   * is what every child starts from.
+   *
+   * \returns the value returned by each job, or FAILED for a job whose child
+   *          crashed or was killed
+   */
+  std::vector<uint32_t>
+  Run (uint32_t nJobs, Callback<uint32_t, uint32_t> job)
+  {
+    std::vector<uint32_t> results (nJobs, FAILED);
+    std::map<pid_t, std::pair<uint32_t, int> > running;
+    uint32_t next = 0;
+
+    // Anything still buffered would otherwise be printed once per child.
+    std::cout.flush ();
+    std::cerr.flush ();
+
+    while (next < nJobs || !running.empty ())
+      {
+        while (next < nJobs && running.size () < m_maxJobs)
+          {
+            int fds[2];
+            if (pipe (fds) != 0)
+              {
+                NS_FATAL_ERROR ("Unable to create a sweep pipe: " << strerror (errno));
+              }
+            pid_t pid = fork ();
+            if (pid < 0)
+              {
+                NS_FATAL_ERROR ("Unable to fork a sweep worker: " << strerror (errno));
+              }
+            if (pid == 0)
+              {
+                close (fds[0]);
+                uint32_t result = job (next);
+                ssize_t written = write (fds[1], &result, sizeof (result));
+                close (fds[1]);
+                std::cout.flush ();
+                _exit (written == sizeof (result) ? 0 : 1);
+              }
+            close (fds[1]);
+            running[pid] = std::make_pair (next, fds[0]);
+            ++next;
+          }
+
+        int status = 0;
+        pid_t pid = waitpid (-1, &status, 0);
+        if (pid < 0)
+          {
+            NS_FATAL_ERROR ("waitpid failed: " << strerror (errno));
+          }
+        std::map<pid_t, std::pair<uint32_t, int> >::iterator i = running.find (pid);
+        if (i == running.end ())
+          {
+            continue;
+          }
+        uint32_t result;
+        if (WIFEXITED (status) && WEXITSTATUS (status) == 0
+            && read (i->second.second, &result, sizeof (result)) == sizeof (result))
+          {
+            results[i->second.first] = result;
+          }
+        close (i->second.second);
+        running.erase (i);
+      }
+    return results;
+  }
+
+  /**
+   * Parses a comma separated list of numbers such as "100,110.5,120".
+   */
+  static std::vector<double>
+  ParseValues (std::string list)
+  {
+    std::vector<double> values;
+    std::istringstream iss (list);
+    std::string item;
+    while (std::getline (iss, item, ','))
+      {
+        if (item.empty ())
+          {
+            continue;
+          }
+        char *end;
+        double value = std::strtod (item.c_str (), &end);
+        if (*end != '\0')
+          {
+            NS_FATAL_ERROR ("Not a number in sweep list: \"" << item << "\"");
+          }
+        values.push_back (value);
+      }
+    return values;
+  }
+
+private:
+  uint32_t m_maxJobs;
+};
+
+const uint32_t ForkSweep::FAILED;
+
+} // namespace ns3
+
+#endif /* FORK_SWEEP_H */
@@ -0,0 +1,409 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef IPV4_ON_DEMAND_ROUTING_H
+#define IPV4_ON_DEMAND_ROUTING_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include "spf-routing-helper.h"
+
+#include <algorithm>
+#include <iostream>
+#include <list>
+#include <map>
+
+namespace ns3 {
+
+/**
+ * Unicast routing protocol that works out a route the first time a
+ * destination is asked for, instead of holding a full table.
+ *
+ * Routes come from a topology graph shared by all nodes (an
+ * SpfRoutingHelper on which Build was called), searched only as far as
+ * the destination's subnet.  Each node keeps the answers for at most
+ * MaxEntries destinations in least recently used order; on top of that,
+ * the total over all nodes is capped by SetGlobalLimit.  A node that would
+ * go over it evicts its own oldest entry first; if it holds none, the
+ * route is used without being cached.  A topology change
+ * recorded by the graph, or any interface change on the node, empties the
+ * node's cache.
+ */
+class Ipv4OnDemandRouting : public Ipv4RoutingProtocol
+{
+public:
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::Ipv4OnDemandRouting")
+      .SetParent<Ipv4RoutingProtocol> ()
+      .AddConstructor<Ipv4OnDemandRouting> ()
+      .AddAttribute ("MaxEntries",
+                     "Destinations whose route this node remembers.",
+                     UintegerValue (64),
+                     MakeUintegerAccessor (&Ipv4OnDemandRouting::m_maxEntries),
+                     MakeUintegerChecker<uint32_t> (1))
+    ;
+    return tid;
+  }
+
+  /// Counters summed over every node
+  struct Stats
+  {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    // Routes handed out without caching them, the global limit being reached
+    uint64_t uncached;
+    uint64_t entries;
+    uint64_t peakEntries;
+  };
+
+  Ipv4OnDemandRouting ()
+    : m_graph (0),
+      m_maxEntries (64),
+      m_generation (0)
+  {
+  }
+
+  virtual
+  ~Ipv4OnDemandRouting ()
+  {
+    Flush ();
+  }
+
+  void
+  SetGraph (SpfRoutingHelper *graph)
+  {
+    m_graph = graph;
+    Flush ();
+  }
+
+  /**
+   * Caps the number of entries held by all nodes together (0 for no cap).
+   */
+  static void
+  SetGlobalLimit (uint64_t limit)
+  {
+    GetGlobalLimit () = limit;
+  }
+
+  static Stats &
+  GetStats (void)
+  {
+    static Stats stats = { 0, 0, 0, 0, 0, 0 };
+    return stats;
+  }
+
+  /**
+   * Approximate memory held by one cached route: the entry, its list
+   * node, its index node and the Ipv4Route it shares.
+   */
+  static uint32_t
+  GetEntryBytes (void)
+  {
+    return sizeof (Entry) + 2 * sizeof (void *)
+           + sizeof (std::pair<const uint32_t, std::list<Entry>::iterator>) + 4 * sizeof (void *)
+           + sizeof (Ipv4Route);
+  }
+
+  static void
+  PrintStats (std::ostream &os)
+  {
+    const Stats &s = GetStats ();
+    uint64_t lookups = s.hits + s.misses;
+    os << "On-demand routing: " << lookups << " lookups, "
+       << (lookups == 0 ? 0.0 : 100.0 * s.hits / lookups) << "% hits, "
+       << s.evictions << " evictions, " << s.uncached << " uncached, " << s.entries << " routes resident ("
+       << s.entries * GetEntryBytes () << " bytes), peak " << s.peakEntries << " ("
+       << s.peakEntries * GetEntryBytes () << " bytes)" << std::endl;
+  }
+
+  virtual Ptr<Ipv4Route>
+  RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
+  {
+    Ptr<Ipv4Route> route;
+    if (!header.GetDestination ().IsMulticast ())
+      {
+        route = Lookup (header.GetDestination ());
+      }
+    if (route == 0 || (oif != 0 && route->GetOutputDevice () != oif))
+      {
+        sockerr = Socket::ERROR_NOROUTETOHOST;
+        return 0;
+      }
+    sockerr = Socket::ERROR_NOTERROR;
+    return route;
+  }
+
+  virtual bool
+  RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+              UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+              LocalDeliverCallback lcb, ErrorCallback ecb)
+  {
+    NS_ASSERT (m_ipv4 != 0);
+    NS_ASSERT (m_ipv4->GetInterfaceForDevice (idev) >= 0);
+    uint32_t iif = m_ipv4->GetInterfaceForDevice (idev);
+    if (m_ipv4->IsDestinationAddress (header.GetDestination (), iif))
+      {
+        if (!lcb.IsNull ())
+          {
+            lcb (p, header, iif);
+            return true;
+          }
+        return false;
+      }
+    if (!m_ipv4->IsForwarding (iif))
+      {
+        ecb (p, header, Socket::ERROR_NOROUTETOHOST);
+        return true;
+      }
+    if (header.GetDestination ().IsMulticast ())
+      {
+        return false;
+      }
+    Ptr<Ipv4Route> route = Lookup (header.GetDestination ());
+    if (route == 0)
+      {
+        return false;
+      }
+    ucb (route, p, header);
+    return true;
+  }
+
+  virtual void
+  NotifyInterfaceUp (uint32_t interface)
+  {
+    Flush ();
+  }
+
+  virtual void
+  NotifyInterfaceDown (uint32_t interface)
+  {
+    Flush ();
+  }
+
+  virtual void
+  NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
+  {
+    Flush ();
+  }
+
+  virtual void
+  NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
+  {
+    Flush ();
+  }
+
+  virtual void
+  SetIpv4 (Ptr<Ipv4> ipv4)
+  {
+    m_ipv4 = ipv4;
+    Flush ();
+  }
+
+  virtual void
+  PrintRoutingTable (Ptr<OutputStreamWrapper> stream) const
+  {
+    std::ostream *os = stream->GetStream ();
+    *os << "Node: " << m_ipv4->GetObject<Node> ()->GetId ()
+        << ", Time: " << Simulator::Now ().GetSeconds () << "s"
+        << ", Ipv4OnDemandRouting cache (" << m_lru.size () << " of " << m_maxEntries << ")" << std::endl;
+    for (std::list<Entry>::const_iterator e = m_lru.begin (); e != m_lru.end (); ++e)
+      {
+        *os << Ipv4Address (e->destination) << " ";
+        if (e->route == 0)
+          {
+            *os << "unreachable" << std::endl;
+          }
+        else
+          {
+            *os << "via " << e->route->GetGateway () << " dev " << e->route->GetOutputDevice ()->GetIfIndex ()
+                << std::endl;
+          }
+      }
+  }
+
+protected:
+  virtual void
+  DoDispose (void)
+  {
+    Flush ();
+    m_ipv4 = 0;
+    Ipv4RoutingProtocol::DoDispose ();
+  }
+
+private:
+  struct Entry
+  {
+    uint32_t destination;
+    Ptr<Ipv4Route> route;
+  };
+
+  static uint64_t &
+  GetGlobalLimit (void)
+  {
+    static uint64_t limit = 0;
+    return limit;
+  }
+
+  Ptr<Ipv4Route>
+  Lookup (Ipv4Address destination)
+  {
+    NS_ABORT_MSG_IF (m_graph == 0, "Ipv4OnDemandRouting has no graph; use Ipv4OnDemandRoutingHelper");
+    Stats &stats = GetStats ();
+    if (m_generation != m_graph->GetGeneration ())
+      {
+        Flush ();
+        m_generation = m_graph->GetGeneration ();
+      }
+
+    uint32_t key = destination.Get ();
+    std::map<uint32_t, std::list<Entry>::iterator>::iterator found = m_index.find (key);
+    if (found != m_index.end ())
+      {
+        ++stats.hits;
+        // Most recently used entries are kept at the front.
+        m_lru.splice (m_lru.begin (), m_lru, found->second);
+        return found->second->route;
+      }
+    ++stats.misses;
+
+    Entry entry;
+    entry.destination = key;
+    uint32_t interface;
+    Ipv4Address gateway;
+    uint32_t metric;
+    uint32_t node = m_ipv4->GetObject<Node> ()->GetId ();
+    if (m_graph->FindFirstHop (node, destination, interface, gateway, metric) && m_ipv4->IsUp (interface))
+      {
+        entry.route = Create<Ipv4Route> ();
+        entry.route->SetDestination (destination);
+        entry.route->SetGateway (gateway);
+        entry.route->SetOutputDevice (m_ipv4->GetNetDevice (interface));
+        entry.route->SetSource (m_ipv4->GetAddress (interface, 0).GetLocal ());
+      }
+
+    if (m_lru.size () >= m_maxEntries)
+      {
+        EvictOldest ();
+      }
+    // Entries of other nodes may have filled the global budget.  Give up at
+    // most one of ours for it, so that a node never empties its cache on a
+    // single lookup, and don't cache if that is not enough.
+    uint64_t limit = GetGlobalLimit ();
+    if (limit != 0 && stats.entries >= limit && !m_lru.empty ())
+      {
+        EvictOldest ();
+      }
+    if (limit != 0 && stats.entries >= limit)
+      {
+        ++stats.uncached;
+        return entry.route;
+      }
+    m_lru.push_front (entry);
+    m_index[key] = m_lru.begin ();
+    ++stats.entries;
+    stats.peakEntries = std::max (stats.peakEntries, stats.entries);
+    return entry.route;
+  }
+
+  void
+  EvictOldest (void)
+  {
+    Stats &stats = GetStats ();
+    m_index.erase (m_lru.back ().destination);
+    m_lru.pop_back ();
+    --stats.entries;
+    ++stats.evictions;
+  }
+
+  void
+  Flush (void)
+  {
+    GetStats ().entries -= m_lru.size ();
+    m_lru.clear ();
+    m_index.clear ();
+  }
+
+  Ptr<Ipv4> m_ipv4;
+  SpfRoutingHelper *m_graph;
+  uint32_t m_maxEntries;
+  uint32_t m_generation;
+  std::list<Entry> m_lru;
+  std::map<uint32_t, std::list<Entry>::iterator> m_index;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (Ipv4OnDemandRouting);
+
+/**
+ * Builds the shared topology graph and gives every node with an internet
+ * stack an Ipv4OnDemandRouting using it.  The helper owns the graph, so it
+ * must live until the simulation is destroyed.
+ */
+class Ipv4OnDemandRoutingHelper
+{
+public:
+  Ipv4OnDemandRoutingHelper (uint32_t maxEntries = 64)
+    : m_maxEntries (maxEntries)
+  {
+  }
+
+  /**
+   * Call once addresses are assigned, where PopulateRoutingTables would
+   * be called.  The protocol goes after Ipv4StaticRouting, which still
+   * answers for directly connected networks.
+   */
+  void
+  InstallAll (int16_t priority = -5)
+  {
+    m_graph.Build ();
+    for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+      {
+        Ptr<Ipv4> ipv4 = (*n)->GetObject<Ipv4> ();
+        if (ipv4 == 0)
+          {
+            continue;
+          }
+        Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting> (ipv4->GetRoutingProtocol ());
+        NS_ABORT_MSG_IF (list == 0, "Node " << (*n)->GetId () << " does not use Ipv4ListRouting");
+        Ptr<Ipv4OnDemandRouting> routing = CreateObject<Ipv4OnDemandRouting> ();
+        routing->SetAttribute ("MaxEntries", UintegerValue (m_maxEntries));
+        routing->SetGraph (&m_graph);
+        list->AddRoutingProtocol (routing, priority);
+      }
+  }
+
+  /**
+   * Tells the graph that interface of node went up or down; every node
+   * drops its cached routes.
+   */
+  void
+  NotifyInterfaceChanged (Ptr<Node> node, uint32_t interface)
+  {
+    m_graph.NotifyInterfaceChanged (node, interface);
+  }
+
+private:
+  uint32_t m_maxEntries;
+  SpfRoutingHelper m_graph;
+};
+
+} // namespace ns3
+
+#endif /* IPV4_ON_DEMAND_ROUTING_H */
@@ -0,0 +1,551 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef IPV4_TRIE_ROUTING_H
+#define IPV4_TRIE_ROUTING_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Unicast routing protocol answering lookups from a path-compressed binary
+ * trie, with a small direct-mapped cache of recent destinations in front
+ * of it.
+ *
+ * Ipv4GlobalRouting and Ipv4StaticRouting walk their whole route list for
+ * every packet.  Here a lookup touches at most one trie node per prefix
+ * length present on the path (never more than 33), whatever the number of
+ * routes, and a cache hit reuses the Ipv4Route built for an earlier packet
+ * to the same destination.  Any change to the table or to an interface
+ * invalidates the whole cache at once.
+ *
+ * It is meant to sit in a node's Ipv4ListRouting below Ipv4StaticRouting
+ * (which keeps answering for directly connected networks) and above
+ * Ipv4GlobalRouting; see Ipv4TrieRoutingHelper for filling it.
+ */
+class Ipv4TrieRouting : public Ipv4RoutingProtocol
+{
+public:
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::Ipv4TrieRouting")
+      .SetParent<Ipv4RoutingProtocol> ()
+      .AddConstructor<Ipv4TrieRouting> ()
+      .AddAttribute ("CacheSize",
+                     "Entries of the destination cache, rounded up to a power of two (0 disables it).",
+                     UintegerValue (256),
+                     MakeUintegerAccessor (&Ipv4TrieRouting::m_cacheSize),
+                     MakeUintegerChecker<uint32_t> ())
+    ;
+    return tid;
+  }
+
+  Ipv4TrieRouting ()
+    : m_cacheSize (256),
+      m_generation (1),
+      m_cacheHits (0),
+      m_cacheMisses (0)
+  {
+    Clear ();
+  }
+
+  /**
+   * \returns the Ipv4TrieRouting of ipv4, directly or inside its
+   *          Ipv4ListRouting, or 0 if there is none
+   */
+  static Ptr<Ipv4TrieRouting>
+  Get (Ptr<Ipv4> ipv4)
+  {
+    Ptr<Ipv4RoutingProtocol> protocol = ipv4->GetRoutingProtocol ();
+    Ptr<Ipv4TrieRouting> trie = DynamicCast<Ipv4TrieRouting> (protocol);
+    Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting> (protocol);
+    for (uint32_t i = 0; trie == 0 && list != 0 && i < list->GetNRoutingProtocols (); ++i)
+      {
+        int16_t priority;
+        trie = DynamicCast<Ipv4TrieRouting> (list->GetRoutingProtocol (i, priority));
+      }
+    return trie;
+  }
+
+  void
+  AddNetworkRouteTo (Ipv4Address network, Ipv4Mask mask, Ipv4Address gateway, uint32_t interface,
+                     uint32_t metric = 0)
+  {
+    Route r;
+    r.length = mask.GetPrefixLength ();
+    r.network = network.Get () & MaskOf (r.length);
+    r.gateway = gateway.Get ();
+    r.interface = interface;
+    r.metric = metric;
+    m_routes.push_back (r);
+    Insert (m_routes.size () - 1);
+    Invalidate ();
+  }
+
+  void
+  AddHostRouteTo (Ipv4Address dest, Ipv4Address gateway, uint32_t interface, uint32_t metric = 0)
+  {
+    AddNetworkRouteTo (dest, Ipv4Mask::GetOnes (), gateway, interface, metric);
+  }
+
+  /**
+   * Removes every route.
+   */
+  void
+  Clear (void)
+  {
+    m_routes.clear ();
+    m_nodes.assign (1, TrieNode ());
+    m_nodes[0].prefix = 0;
+    m_nodes[0].length = 0;
+    m_nodes[0].route = -1;
+    m_nodes[0].child[0] = 0;
+    m_nodes[0].child[1] = 0;
+    Invalidate ();
+  }
+
+  uint32_t
+  GetNRoutes (void) const
+  {
+    return m_routes.size ();
+  }
+
+  uint64_t
+  GetCacheHits (void) const
+  {
+    return m_cacheHits;
+  }
+
+  uint64_t
+  GetCacheMisses (void) const
+  {
+    return m_cacheMisses;
+  }
+
+  virtual Ptr<Ipv4Route>
+  RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
+  {
+    Ptr<Ipv4Route> route;
+    if (!header.GetDestination ().IsMulticast ())
+      {
+        route = Lookup (header.GetDestination ());
+      }
+    if (route == 0 || (oif != 0 && route->GetOutputDevice () != oif))
+      {
+        sockerr = Socket::ERROR_NOROUTETOHOST;
+        return 0;
+      }
+    sockerr = Socket::ERROR_NOTERROR;
+    return route;
+  }
+
+  virtual bool
+  RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+              UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+              LocalDeliverCallback lcb, ErrorCallback ecb)
+  {
+    // Same checks, in the same order, as Ipv4GlobalRouting::RouteInput
+    NS_ASSERT (m_ipv4 != 0);
+    NS_ASSERT (m_ipv4->GetInterfaceForDevice (idev) >= 0);
+    uint32_t iif = m_ipv4->GetInterfaceForDevice (idev);
+    if (m_ipv4->IsDestinationAddress (header.GetDestination (), iif))
+      {
+        if (!lcb.IsNull ())
+          {
+            lcb (p, header, iif);
+            return true;
+          }
+        return false;
+      }
+    if (!m_ipv4->IsForwarding (iif))
+      {
+        ecb (p, header, Socket::ERROR_NOROUTETOHOST);
+        return true;
+      }
+    if (header.GetDestination ().IsMulticast ())
+      {
+        return false;
+      }
+    Ptr<Ipv4Route> route = Lookup (header.GetDestination ());
+    if (route == 0)
+      {
+        return false;
+      }
+    ucb (route, p, header);
+    return true;
+  }
+
+  virtual void
+  NotifyInterfaceUp (uint32_t interface)
+  {
+    Invalidate ();
+  }
+
+  virtual void
+  NotifyInterfaceDown (uint32_t interface)
+  {
+    Invalidate ();
+  }
+
+  virtual void
+  NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
+  {
+    Invalidate ();
+  }
+
+  virtual void
+  NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
+  {
+    Invalidate ();
+  }
+
+  virtual void
+  SetIpv4 (Ptr<Ipv4> ipv4)
+  {
+    m_ipv4 = ipv4;
+    Invalidate ();
+  }
+
+  virtual void
+  PrintRoutingTable (Ptr<OutputStreamWrapper> stream) const
+  {
+    std::ostream *os = stream->GetStream ();
+    *os << "Node: " << m_ipv4->GetObject<Node> ()->GetId ()
+        << ", Time: " << Simulator::Now ().GetSeconds () << "s"
+        << ", Ipv4TrieRouting table (" << m_cacheHits << " cache hits, "
+        << m_cacheMisses << " misses)" << std::endl;
+    *os << "Destination        Gateway         Iface  Metric" << std::endl;
+    for (std::vector<Route>::const_iterator r = m_routes.begin (); r != m_routes.end (); ++r)
+      {
+        std::ostringstream dest;
+        dest << Ipv4Address (r->network) << "/" << uint32_t (r->length);
+        std::ostringstream gateway;
+        gateway << Ipv4Address (r->gateway);
+        *os << std::setiosflags (std::ios::left) << std::setw (19) << dest.str ()
+            << std::setw (16) << gateway.str () << std::setw (7) << r->interface
+            << r->metric << std::resetiosflags (std::ios::left) << std::endl;
+      }
+  }
+
+protected:
+  virtual void
+  DoDispose (void)
+  {
+    m_ipv4 = 0;
+    m_cache.clear ();
+    Ipv4RoutingProtocol::DoDispose ();
+  }
+
+private:
+  struct Route
+  {
+    uint32_t network;
+    uint8_t length;
+    uint32_t gateway;
+    uint32_t interface;
+    uint32_t metric;
+  };
+
+  // Children are indices into m_nodes; 0 (the root) means no child.
+  struct TrieNode
+  {
+    uint32_t prefix;
+    uint8_t length;
+    int32_t route;
+    uint32_t child[2];
+  };
+
+  struct CacheEntry
+  {
+    uint32_t destination;
+    uint32_t generation;
+    Ptr<Ipv4Route> route;
+  };
+
+  static uint32_t
+  MaskOf (uint32_t length)
+  {
+    return length == 0 ? 0 : 0xffffffff << (32 - length);
+  }
+
+  // Bit i of address, counting from the most significant one
+  static uint32_t
+  BitOf (uint32_t address, uint32_t i)
+  {
+    return (address >> (31 - i)) & 1;
+  }
+
+  static uint32_t
+  CommonLength (uint32_t a, uint32_t b, uint32_t max)
+  {
+    uint32_t x = a ^ b;
+    uint32_t common = x == 0 ? 32 : __builtin_clz (x);
+    return std::min (common, max);
+  }
+
+  uint32_t
+  NewNode (uint32_t prefix, uint32_t length, int32_t route)
+  {
+    TrieNode n;
+    n.prefix = prefix & MaskOf (length);
+    n.length = length;
+    n.route = route;
+    n.child[0] = 0;
+    n.child[1] = 0;
+    m_nodes.push_back (n);
+    return m_nodes.size () - 1;
+  }
+
+  void
+  Insert (int32_t index)
+  {
+    uint32_t prefix = m_routes[index].network;
+    uint32_t length = m_routes[index].length;
+    uint32_t n = 0;
+    while (true)
+      {
+        // m_nodes[n] covers prefix and is shorter than it, or equal.
+        if (m_nodes[n].length == length)
+          {
+            int32_t old = m_nodes[n].route;
+            if (old < 0 || m_routes[index].metric < m_routes[old].metric)
+              {
+                m_nodes[n].route = index;
+              }
+            return;
+          }
+        uint32_t bit = BitOf (prefix, m_nodes[n].length);
+        uint32_t c = m_nodes[n].child[bit];
+        if (c == 0)
+          {
+            uint32_t leaf = NewNode (prefix, length, index);
+            m_nodes[n].child[bit] = leaf;
+            return;
+          }
+        uint32_t childPrefix = m_nodes[c].prefix;
+        uint32_t childLength = m_nodes[c].length;
+        uint32_t common = CommonLength (prefix, childPrefix, std::min (length, childLength));
+        if (common == childLength)
+          {
+            n = c;
+            continue;
+          }
+        if (common == length)
+          {
+            // The new prefix sits between n and its child.
+            uint32_t inner = NewNode (prefix, length, index);
+            m_nodes[inner].child[BitOf (childPrefix, length)] = c;
+            m_nodes[n].child[bit] = inner;
+            return;
+          }
+        // The paths part at common: add a branching node there.
+        uint32_t branch = NewNode (prefix, common, -1);
+        uint32_t leaf = NewNode (prefix, length, index);
+        m_nodes[branch].child[BitOf (prefix, common)] = leaf;
+        m_nodes[branch].child[BitOf (childPrefix, common)] = c;
+        m_nodes[n].child[bit] = branch;
+        return;
+      }
+  }
+
+  int32_t
+  Match (uint32_t address) const
+  {
+    int32_t best = -1;
+    uint32_t n = 0;
+    while (true)
+      {
+        const TrieNode &node = m_nodes[n];
+        if (((address ^ node.prefix) & MaskOf (node.length)) != 0)
+          {
+            break;
+          }
+        if (node.route >= 0)
+          {
+            best = node.route;
+          }
+        if (node.length == 32)
+          {
+            break;
+          }
+        n = node.child[BitOf (address, node.length)];
+        if (n == 0)
+          {
+            break;
+          }
+      }
+    return best;
+  }
+
+  Ptr<Ipv4Route>
+  Lookup (Ipv4Address destination)
+  {
+    uint32_t key = destination.Get ();
+    CacheEntry *entry = 0;
+    if (m_cacheSize != 0)
+      {
+        if (m_cache.empty ())
+          {
+            uint32_t size = 1;
+            while (size < m_cacheSize)
+              {
+                size <<= 1;
+              }
+            m_cache.resize (size);
+          }
+        entry = &m_cache[(key * 2654435761u) >> 16 & (m_cache.size () - 1)];
+        if (entry->generation == m_generation && entry->destination == key)
+          {
+            ++m_cacheHits;
+            return entry->route;
+          }
+      }
+    ++m_cacheMisses;
+
+    Ptr<Ipv4Route> route;
+    int32_t index = Match (key);
+    if (index >= 0 && m_ipv4->IsUp (m_routes[index].interface))
+      {
+        const Route &r = m_routes[index];
+        route = Create<Ipv4Route> ();
+        route->SetDestination (destination);
+        route->SetGateway (Ipv4Address (r.gateway));
+        route->SetOutputDevice (m_ipv4->GetNetDevice (r.interface));
+        route->SetSource (m_ipv4->GetAddress (r.interface, 0).GetLocal ());
+      }
+    if (entry != 0)
+      {
+        entry->destination = key;
+        entry->generation = m_generation;
+        entry->route = route;
+      }
+    return route;
+  }
+
+  void
+  Invalidate (void)
+  {
+    ++m_generation;
+  }
+
+  Ptr<Ipv4> m_ipv4;
+  std::vector<Route> m_routes;
+  std::vector<TrieNode> m_nodes;
+  uint32_t m_cacheSize;
+  std::vector<CacheEntry> m_cache;
+  // Cache entries of an older generation are stale
+  uint32_t m_generation;
+  uint64_t m_cacheHits;
+  uint64_t m_cacheMisses;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (Ipv4TrieRouting);
+
+/**
+ * Adds Ipv4TrieRouting to nodes that already have an internet stack, and
+ * fills it from the routes Ipv4GlobalRouting computed.
+ */
+class Ipv4TrieRoutingHelper
+{
+public:
+  /**
+   * Inserts an Ipv4TrieRouting into the node's Ipv4ListRouting.  The
+   * default priority puts it after Ipv4StaticRouting (0) and before
+   * Ipv4GlobalRouting (-10), as set up by InternetStackHelper.
+   */
+  static Ptr<Ipv4TrieRouting>
+  Install (Ptr<Node> node, int16_t priority = -5)
+  {
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+    NS_ABORT_MSG_IF (ipv4 == 0, "Install an internet stack on node " << node->GetId () << " first");
+    Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting> (ipv4->GetRoutingProtocol ());
+    NS_ABORT_MSG_IF (list == 0, "Node " << node->GetId () << " does not use Ipv4ListRouting");
+    Ptr<Ipv4TrieRouting> trie = CreateObject<Ipv4TrieRouting> ();
+    list->AddRoutingProtocol (trie, priority);
+    return trie;
+  }
+
+  static void
+  Install (NodeContainer c, int16_t priority = -5)
+  {
+    for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+      {
+        Install (*i, priority);
+      }
+  }
+
+  /**
+   * Installs on every node that has an internet stack.
+   */
+  static void
+  InstallAll (int16_t priority = -5)
+  {
+    for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+      {
+        if ((*n)->GetObject<Ipv4> () != 0)
+          {
+            Install (*n, priority);
+          }
+      }
+  }
+
+  /**
+   * Copies the routes of every node's Ipv4GlobalRouting into its
+   * Ipv4TrieRouting; call after Ipv4GlobalRoutingHelper::PopulateRoutingTables.
+   */
+  static void
+  PopulateFromGlobal (void)
+  {
+    for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+      {
+        Ptr<Ipv4> ipv4 = (*n)->GetObject<Ipv4> ();
+        Ptr<Ipv4TrieRouting> trie = ipv4 == 0 ? 0 : Ipv4TrieRouting::Get (ipv4);
+        if (trie == 0)
+          {
+            continue;
+          }
+        Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting> (ipv4->GetRoutingProtocol ());
+        Ptr<Ipv4GlobalRouting> global;
+        for (uint32_t i = 0; global == 0 && i < list->GetNRoutingProtocols (); ++i)
+          {
+            int16_t priority;
+            global = DynamicCast<Ipv4GlobalRouting> (list->GetRoutingProtocol (i, priority));
+          }
+        NS_ABORT_MSG_IF (global == 0, "Node " << (*n)->GetId () << " has no Ipv4GlobalRouting");
+
+        trie->Clear ();
+        for (uint32_t i = 0; i < global->GetNRoutes (); ++i)
+          {
+            Ipv4RoutingTableEntry *entry = global->GetRoute (i);
+            trie->AddNetworkRouteTo (entry->GetDest (), entry->GetDestNetworkMask (),
+                                     entry->GetGateway (), entry->GetInterface ());
+          }
+      }
+  }
+};
+
+} // namespace ns3
+
+#endif /* IPV4_TRIE_ROUTING_H */
@@ -22,6 +22,18 @@
 #include "ns3/applications-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
 
+#include "async-pcap-helper.h"
+#include "flight-recorder-helper.h"
+#include "flow-stats-collector.h"
+#include "ipv4-on-demand-routing.h"
+#include "profiling-scheduler.h"
+#include "scenario-bench.h"
+#include "spf-routing-helper.h"
+#include "static-arp-helper.h"
+#include "udp-echo-rtt-client.h"
+
+#include <limits>
+
 //Network Topology
 //
 ////    10.3.1.0   10.2.1.0    10.1.1.0
@@ -34,17 +46,101 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("SecondScriptExample");
 
+// Echo requests sent and replies received by n0, for the flight recorder's
+// echo timeout trigger
+static uint32_t g_echoesSent = 0;
+static uint32_t g_repliesReceived = 0;
+static FlightRecorderHelper *g_recorder = 0;
+static Time g_echoTimeout;
+
+static bool
+RepliesMissing (uint32_t expected)
+{
+  return g_repliesReceived < expected;
+}
+
+static void
+EchoSent (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+  UdpHeader udpHeader;
+  if (header.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+    {
+      return;
+    }
+  packet->PeekHeader (udpHeader);
+  if (udpHeader.GetDestinationPort () == 9)
+    {
+      ++g_echoesSent;
+      g_recorder->TriggerAt (Simulator::Now () + g_echoTimeout,
+                             MakeBoundCallback (&RepliesMissing, g_echoesSent), "echo timeout");
+    }
+}
+
+static void
+EchoReplyDelivered (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+{
+  UdpHeader udpHeader;
+  if (header.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+    {
+      return;
+    }
+  packet->PeekHeader (udpHeader);
+  if (udpHeader.GetSourcePort () == 9)
+    {
+      ++g_repliesReceived;
+    }
+}
+
 int 
 main (int argc, char *argv[])
 {
   bool verbose = true;
   uint32_t nCsma = 2;
+  std::string pcapCompression = "none";
+  uint32_t flightRecorder = 0;
+  double flightWindow = 0.0;
+  double echoTimeout = 0.5;
+  std::string routing = "global";
+  bool staticArp = false;
+  bool trieRouting = false;
+  bool tracing = true;
+  uint32_t nPackets = 0;
+  std::string benchOutput = "";
+  std::string profileEvents = "";
+  std::string flowStats = "";
+  bool rtt = false;
+  std::string echoRate = "";
+  uint32_t burst = 1;
 
   CommandLine cmd;
   cmd.AddValue ("nCsma", "Number of \"extra\" CSMA nodes/devices", nCsma);
   cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+  cmd.AddValue ("pcapCompression", "Compress pcap files while writing them: none, gzip or zstd", pcapCompression);
+  cmd.AddValue ("flightRecorder", "Instead of full pcap, keep this many packets per device and only "
+                "write them out on a drop or an echo timeout (0 = full pcap)", flightRecorder);
+  cmd.AddValue ("flightWindow", "Only dump packets from the last this many seconds (0 = no limit)", flightWindow);
+  cmd.AddValue ("echoTimeout", "Seconds after which a missing echo reply triggers a dump", echoTimeout);
+  cmd.AddValue ("routing", "How routes are computed: global (Ipv4GlobalRoutingHelper), spf (parallel SpfRoutingHelper) or on-demand (first use, cached per node)", routing);
+  cmd.AddValue ("trieRouting", "Forward through an LPM trie with a route cache instead of the route lists", trieRouting);
+  cmd.AddValue ("staticArp", "Fill ARP caches from the address assignments instead of resolving on the bus", staticArp);
+  cmd.AddValue ("tracing", "Write the pcap files (or the flight recorder dumps)", tracing);
+  cmd.AddValue ("nPackets", "Packets sent by each echo client (0 = 50 and 3)", nPackets);
+  cmd.AddValue ("benchOutput", "Append wall time, events, memory and allocations of the run to this file", benchOutput);
+  cmd.AddValue ("profileEvents", "Write the wall time of each kind of event to this file, as folded stacks for flamegraph.pl", profileEvents);
+  cmd.AddValue ("flowStats", "Write per-flow packet, delay and jitter counters to this file (CSV, or JSON if it ends in .json)", flowStats);
+  cmd.AddValue ("rtt", "Echo clients measure round trip times into histograms, instead of logging each packet", rtt);
+  cmd.AddValue ("echoRate", "Rate offered by the echo client of the CSMA server, e.g. 100Mbps (implies --rtt)", echoRate);
+  cmd.AddValue ("burst", "Packets that client sends per event at --echoRate", burst);
 
   cmd.Parse (argc,argv);
+  rtt = rtt || !echoRate.empty ();
+
+  if (!profileEvents.empty ())
+    {
+      ProfilingScheduler::Enable (profileEvents);
+    }
+  ScenarioBench bench ("lab3p2", benchOutput, argc, argv);
+  bench.SetPackets (nPackets);
 
   if (verbose)
     {
@@ -104,6 +200,11 @@ main (int argc, char *argv[])
   address.SetBase ("10.1.2.0", "255.255.255.0");
   Ipv4InterfaceContainer csmaInterfaces;
   csmaInterfaces = address.Assign (csmaDevices);
+
+  if (staticArp)
+    {
+      StaticArpHelper::Populate (csmaInterfaces);
+    }
  
   // 5. Create Applications:
   
@@ -126,7 +227,7 @@ main (int argc, char *argv[])
   serverApps2.Start (Seconds (1.0));
   serverApps2.Stop (Seconds (5.0));
 
-  UdpEchoClientHelper echoClient2 (p2pInterfaces3.GetAddress (1), 9);
+  UdpEchoRttClientHelper echoClient2 (p2pInterfaces3.GetAddress (1), 9, rtt);
   echoClient2.SetAttribute ("MaxPackets", UintegerValue (50));
   echoClient2.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
   echoClient2.SetAttribute ("PacketSize", UintegerValue (2048));
@@ -143,23 +244,97 @@ main (int argc, char *argv[])
   serverApps.Start (Seconds (8.0));
   serverApps.Stop (Seconds (15.0));
 
-  UdpEchoClientHelper echoClient (csmaInterfaces.GetAddress (nCsma), 9);
+  UdpEchoRttClientHelper echoClient (csmaInterfaces.GetAddress (nCsma), 9, rtt);
   echoClient.SetAttribute ("MaxPackets", UintegerValue (3));
   echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
   echoClient.SetAttribute ("PacketSize", UintegerValue (2048));
+  if (!echoRate.empty ())
+    {
+      // Bursts of burst packets, spaced to average out at the rate, until
+      // the client stops
+      double bits = burst * 2048 * 8.0;
+      echoClient.SetAttribute ("MaxPackets", UintegerValue (std::numeric_limits<uint32_t>::max ()));
+      echoClient.SetAttribute ("Burst", UintegerValue (burst));
+      echoClient.SetAttribute ("Interval", TimeValue (Seconds (bits / DataRate (echoRate).GetBitRate ())));
+    }
 
   ApplicationContainer clientApps = echoClient.Install (p2pNodes.Get (0));
   clientApps.Start (Seconds (9.0));
   clientApps.Stop (Seconds (11.0));
 
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  if (trieRouting)
+    {
+      Ipv4TrieRoutingHelper::InstallAll ();
+    }
+  SpfRoutingHelper spf;
+  Ipv4OnDemandRoutingHelper onDemand;
+  if (routing == "spf")
+    {
+      spf.Populate ();
+    }
+  else if (routing == "global")
+    {
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+      if (trieRouting)
+        {
+          Ipv4TrieRoutingHelper::PopulateFromGlobal ();
+        }
+    }
+  else if (routing == "on-demand")
+    {
+      onDemand.InstallAll ();
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown routing \"" << routing << "\"");
+    }
 
-  pointToPoint.EnablePcapAll ("second");
-  csma.EnablePcap ("second", csmaDevices.Get (1), true);
+  // Same files as pointToPoint.EnablePcapAll and csma.EnablePcap, written
+  // by a background thread (with a .gz/.zst suffix if compressed)
+  AsyncPcapHelper pcap (1 << 20, AsyncPcapHelper::ParseCompression (pcapCompression));
+  FlightRecorderHelper recorder (flightRecorder, Seconds (flightWindow));
+  if (tracing && flightRecorder == 0)
+    {
+      pcap.EnablePcapAll<PointToPointNetDevice> ("second");
+      pcap.EnablePcap ("second", csmaDevices.Get (1), true);
+    }
+  else if (tracing)
+    {
+      recorder.SetPrefix ("second-flight");
+      recorder.Enable (deviceline01);
+      recorder.Enable (deviceline02);
+      recorder.Enable (deviceline23);
+      recorder.Enable (csmaDevices.Get (1), true);
+      recorder.TriggerOnTrace ("/NodeList/*/DeviceList/*/$ns3::PointToPointNetDevice/TxQueue/Drop", "queue drop");
+      recorder.TriggerOnTrace ("/NodeList/*/DeviceList/*/$ns3::PointToPointNetDevice/PhyRxDrop", "receive drop");
+      g_recorder = &recorder;
+      g_echoTimeout = Seconds (echoTimeout);
+      Config::ConnectWithoutContext ("/NodeList/0/$ns3::Ipv4L3Protocol/SendOutgoing", MakeCallback (&EchoSent));
+      Config::ConnectWithoutContext ("/NodeList/0/$ns3::Ipv4L3Protocol/LocalDeliver", MakeCallback (&EchoReplyDelivered));
+    }
   
   
   
+  FlowStatsCollector flows;
+  if (!flowStats.empty ())
+    {
+      flows.Install ();
+    }
+
   Simulator::Run ();
+  if (rtt)
+    {
+      UdpEchoRttClientHelper::PrintAll (std::cout);
+    }
+  if (routing == "on-demand")
+    {
+      Ipv4OnDemandRouting::PrintStats (std::cout);
+    }
+  pcap.Close ();
+  if (!flowStats.empty ())
+    {
+      flows.Write (flowStats);
+    }
   Simulator::Destroy ();
   return 0;
 }
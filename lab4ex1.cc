@@ -23,6 +23,16 @@
 #include "ns3/csma-module.h"
 #include "ns3/internet-module.h"
 
+#include "flow-stats-collector.h"
+#include "ipv4-on-demand-routing.h"
+#include "ladder-scheduler.h"
+#include "quiescence-monitor.h"
+#include "recording-scheduler.h"
+#include "profiling-scheduler.h"
+#include "scenario-bench.h"
+#include "spf-routing-helper.h"
+#include "udp-echo-rtt-client.h"
+
 // Default Network Topology
 //
 //   Wifi 10.1.3.0
@@ -46,62 +56,33 @@ CourseChange (std::string context, Ptr<const MobilityModel> model)
                    " x = " << position.x << ", y = " << position.y);
 }
 
-int 
-main (int argc, char *argv[])
+// One BSS: an AP sitting on the CSMA bus and the STAs wandering around it
+// on a Yans channel of their own.
+struct Cell
 {
-  // Enable Logging
-  bool verbose = true;
-  // nCsma represents the number of extra nodes sharing the LAN besides n1 here.
-  // Same as nWifi
-  uint32_t nCsma = 2;
-  uint32_t nWifi = 3;
-
-  // Adding Command line arguments here.
-  // Use $ ./waf --run "scratch/mysecond --PrintHelp" to see help.
-  // For example: $ ./waf --run "scratch/mysecond --nCsma=100 --nWifi=10"
-  CommandLine cmd;
-  cmd.AddValue ("nCsma", "Number of \"extra\" CSMA nodes/devices", nCsma);
-  cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
-  cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
-
-  cmd.Parse (argc,argv);
-
-  if (nWifi > 18)
-    {
-      std::cout << "Number of wifi nodes " << nWifi << 
-                   " specified exceeds the mobility bounding box" << std::endl;
-      exit (1);
-    }
-
-  if (verbose)
-    {
-      LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
-      LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
-    }
-
-  //Notice that n1 at p2pNodes is added as the 0th node at csmaNodes set
-  NodeContainer csmaNodes;
-  csmaNodes.Create (3);
+  NodeContainer apNode;
+  NodeContainer staNodes;
+  NetDeviceContainer apDevices;
+  NetDeviceContainer staDevices;
+  YansWifiPhyHelper phy;
+};
 
-  CsmaHelper csma;
-  csma.SetChannelAttribute ("DataRate", StringValue ("100Mbps"));
-  csma.SetChannelAttribute ("Delay", TimeValue (NanoSeconds (6560)));
+Cell
+BuildCell (Ptr<Node> apNode, std::string ssidName)
+{
+  Cell cell;
 
-  NetDeviceContainer csmaDevices;
-  csmaDevices = csma.Install (csmaNodes);
-  
   //wifiStaNodes represent wifi Station
   //In IEEE 802.11 (Wi-Fi) terminology, a station (STA) is a device that has the capability to use the 802.11 protocol. For example, a station may be a laptop, a desktop PC, PDA, access point or Wi-Fi phone.
-  NodeContainer wifiStaNodes;
-  wifiStaNodes.Create (2);
-  // use the “leftmost” node of the point-to-point link as the node for the wireless access point
-  NodeContainer wifiApNode = csmaNodes.Get (0);
+  cell.staNodes.Create (2);
+  // use the bus node as the node for the wireless access point
+  cell.apNode = apNode;
 
   // PHY Layer configuration
   YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
-  YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
+  cell.phy = YansWifiPhyHelper::Default ();
   // we create a channel object and associate it to our PHY layer object manager to make sure that all the PHY layer objects created by the YansWifiPhyHelper share the same underlying channel, that is, they share the same wireless medium and can communication and interfere
-  phy.SetChannel (channel.Create ());
+  cell.phy.SetChannel (channel.Create ());
 
   // MAC Layer configuration
   WifiHelper wifi = WifiHelper::Default ();
@@ -112,7 +93,7 @@ main (int argc, char *argv[])
   NqosWifiMacHelper mac = NqosWifiMacHelper::Default ();
 
   // service set identifier (SSID)
-  Ssid ssid = Ssid ("ns-3-ssid");
+  Ssid ssid = Ssid (ssidName);
     
   // the MAC instance next created will be a non-QoS non-AP station (STA) in an infrastructure BSS (i.e., a BSS with an AP
   mac.SetType ("ns3::StaWifiMac",
@@ -120,17 +101,14 @@ main (int argc, char *argv[])
                "ActiveProbing", BooleanValue (false));
 
   // Here phy and mac are set separately, especially they are separated from the Application
-  NetDeviceContainer staDevices;
-  staDevices = wifi.Install (phy, mac, wifiStaNodes);
+  cell.staDevices = wifi.Install (cell.phy, mac, cell.staNodes);
 
   // Change the Type of mac then install phy and mac to wifiApNode
   // If you use two different MAC protocol here, change the following mac to coressponding name.
   mac.SetType ("ns3::ApWifiMac",
                "Ssid", SsidValue (ssid));
 
-  
-  NetDeviceContainer apDevices;
-  apDevices = wifi.Install (phy, mac, wifiApNode);
+  cell.apDevices = wifi.Install (cell.phy, mac, cell.apNode);
   
   // Mobility Model
   // We want the STA nodes to be mobile, wandering around inside a bounding box, and we want to make the AP node stationary.
@@ -148,154 +126,104 @@ main (int argc, char *argv[])
   //RandomWalk2dMobilityModel: the nodes move in a random direction at a random speed around inside a bounding box
   mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
                              "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
-  mobility.Install (wifiStaNodes);
+  mobility.Install (cell.staNodes);
   
   //Another mobility model used for Access Point: fixed position
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
-  mobility.Install (wifiApNode);
- 
-
-  // 2nd Wifi Station
-  //wifiStaNodes represent wifi Station
-  NodeContainer wifiStaNodes2;
-  wifiStaNodes2.Create (2);
-  // use the “leftmost” node of the point-to-point link as the node for the wireless access point
-  NodeContainer wifiApNode2 = csmaNodes.Get (1);
-
-  // PHY Layer configuration
-  YansWifiChannelHelper channel2 = YansWifiChannelHelper::Default ();
-  YansWifiPhyHelper phy2 = YansWifiPhyHelper::Default ();
-  // we create a channel object and associate it to our PHY layer object manager to make sure that all the PHY layer objects created by the YansWifiPhyHelper share the same underlying channel, that is, they share the same wireless medium and can communication and interfere
-  phy2.SetChannel (channel2.Create ());
-
-  // MAC Layer configuration
-  WifiHelper wifi2 = WifiHelper::Default ();
-  // rate control algorithm
-  wifi2.SetRemoteStationManager ("ns3::AarfWifiManager");
-
-  // we choose non-Qos MAC. Qos means Quality of Service
-  NqosWifiMacHelper mac2 = NqosWifiMacHelper::Default ();
-
-  // service set identifier (SSID)
-  Ssid ssid2 = Ssid ("ns-3-ssid-2");
-    
-  // the MAC instance next created will be a non-QoS non-AP station (STA) in an infrastructure BSS (i.e., a BSS with an AP
-  mac2.SetType ("ns3::StaWifiMac",
-               "Ssid", SsidValue (ssid2),
-               "ActiveProbing", BooleanValue (false));
-
-  // Here phy and mac are set separately, especially they are separated from the Application
-  NetDeviceContainer staDevices2;
-  staDevices2 = wifi2.Install (phy2, mac2, wifiStaNodes2);
-
-  // Change the Type of mac then install phy and mac to wifiApNode
-  // If you use two different MAC protocol here, change the following mac to coressponding name.
-  mac2.SetType ("ns3::ApWifiMac",
-               "Ssid", SsidValue (ssid2));
-
-  
-  NetDeviceContainer apDevices2;
-  apDevices2 = wifi2.Install (phy2, mac2, wifiApNode2);
-  
-  // Mobility Model
-  // We want the STA nodes to be mobile, wandering around inside a bounding box, and we want to make the AP node stationary.
-  MobilityHelper mobility2;
-
-  // reference: explore the Doxygen for class ns3::GridPositionAllocator
-  mobility2.SetPositionAllocator ("ns3::GridPositionAllocator",
-                                 "MinX", DoubleValue (0.0),
-                                 "MinY", DoubleValue (0.0),
-                                 "DeltaX", DoubleValue (5.0),
-                                 "DeltaY", DoubleValue (10.0),
-                                 "GridWidth", UintegerValue (3),
-                                 "LayoutType", StringValue ("RowFirst"));
-
-  //RandomWalk2dMobilityModel: the nodes move in a random direction at a random speed around inside a bounding box
-  mobility2.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
-  mobility2.Install (wifiStaNodes2);
+  mobility.Install (cell.apNode);
 
-  //Another mobility model used for Access Point: fixed position
-  mobility2.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
-  mobility2.Install (wifiApNode2);
-  
-  // 3rd Wifi Station
-  //wifiStaNodes represent wifi Station
-  NodeContainer wifiStaNodes3;
-  wifiStaNodes3.Create (2);
-  // use the “leftmost” node of the point-to-point link as the node for the wireless access point
-  NodeContainer wifiApNode3 = csmaNodes.Get (2);
+  return cell;
+}
 
-  // PHY Layer configuration
-  YansWifiChannelHelper channel3 = YansWifiChannelHelper::Default ();
-  YansWifiPhyHelper phy3 = YansWifiPhyHelper::Default ();
-  // we create a channel object and associate it to our PHY layer object manager to make sure that all the PHY layer objects created by the YansWifiPhyHelper share the same underlying channel, that is, they share the same wireless medium and can communication and interfere
-  phy3.SetChannel (channel3.Create ());
+int 
+main (int argc, char *argv[])
+{
+  // Enable Logging
+  bool verbose = true;
+  // nCsma represents the number of extra nodes sharing the LAN besides n1 here.
+  // Same as nWifi
+  uint32_t nCsma = 2;
+  uint32_t nWifi = 3;
+  std::string routing = "global";
+  bool autoStop = false;
+  bool tracing = true;
+  uint32_t nPackets = 0;
+  std::string benchOutput = "";
+  std::string profileEvents = "";
+  std::string flowStats = "";
+  bool rtt = false;
+  std::string recordEvents = "";
 
-  // MAC Layer configuration
-  WifiHelper wifi3 = WifiHelper::Default ();
-  // rate control algorithm
-  wifi3.SetRemoteStationManager ("ns3::AarfWifiManager");
+  // Adding Command line arguments here.
+  // Use $ ./waf --run "scratch/mysecond --PrintHelp" to see help.
+  // For example: $ ./waf --run "scratch/mysecond --nCsma=100 --nWifi=10"
+  CommandLine cmd;
+  cmd.AddValue ("nCsma", "Number of \"extra\" CSMA nodes/devices", nCsma);
+  cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
+  cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+  cmd.AddValue ("routing", "How routes are computed: global (Ipv4GlobalRoutingHelper), spf (parallel SpfRoutingHelper) or on-demand (first use, cached per node)", routing);
+  cmd.AddValue ("autoStop", "End the run once the echo clients are done and the network is idle", autoStop);
+  cmd.AddValue ("tracing", "Write the pcap files", tracing);
+  cmd.AddValue ("nPackets", "Packets sent by the echo client (0 = five)", nPackets);
+  cmd.AddValue ("benchOutput", "Append wall time, events, memory and allocations of the run to this file", benchOutput);
+  cmd.AddValue ("profileEvents", "Write the wall time of each kind of event to this file, as folded stacks for flamegraph.pl", profileEvents);
+  cmd.AddValue ("flowStats", "Write per-flow packet, delay and jitter counters to this file (CSV, or JSON if it ends in .json)", flowStats);
+  cmd.AddValue ("rtt", "Echo clients measure round trip times into histograms, instead of logging each packet", rtt);
+  cmd.AddValue ("recordEvents", "Log every event queue operation to this file, for scheduler-benchmark", recordEvents);
 
-  // we choose non-Qos MAC. Qos means Quality of Service
-  NqosWifiMacHelper mac3 = NqosWifiMacHelper::Default ();
+  cmd.Parse (argc,argv);
 
-  // service set identifier (SSID)
-  Ssid ssid3 = Ssid ("ns-3-ssid-3");
-    
-  // the MAC instance next created will be a non-QoS non-AP station (STA) in an infrastructure BSS (i.e., a BSS with an AP
-  mac3.SetType ("ns3::StaWifiMac",
-               "Ssid", SsidValue (ssid3),
-               "ActiveProbing", BooleanValue (false));
+  if (!recordEvents.empty ())
+    {
+      RecordingScheduler::Enable (recordEvents);
+    }
+  if (!profileEvents.empty ())
+    {
+      ProfilingScheduler::Enable (profileEvents);
+    }
+  ScenarioBench bench ("lab4ex1", benchOutput, argc, argv);
+  bench.SetPackets (nPackets);
 
-  // Here phy and mac are set separately, especially they are separated from the Application
-  NetDeviceContainer staDevices3;
-  staDevices3 = wifi3.Install (phy3, mac3, wifiStaNodes3);
 
-  // Change the Type of mac then install phy and mac to wifiApNode
-  // If you use two different MAC protocol here, change the following mac to coressponding name.
-  mac3.SetType ("ns3::ApWifiMac",
-               "Ssid", SsidValue (ssid3));
+  if (nWifi > 18)
+    {
+      std::cout << "Number of wifi nodes " << nWifi << 
+                   " specified exceeds the mobility bounding box" << std::endl;
+      exit (1);
+    }
 
-  
-  NetDeviceContainer apDevices3;
-  apDevices3 = wifi3.Install (phy3, mac3, wifiApNode3);
-  
-  // Mobility Model
-  // We want the STA nodes to be mobile, wandering around inside a bounding box, and we want to make the AP node stationary.
-  MobilityHelper mobility3;
+  if (verbose)
+    {
+      LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
+      LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
+    }
 
-  // reference: explore the Doxygen for class ns3::GridPositionAllocator
-  mobility3.SetPositionAllocator ("ns3::GridPositionAllocator",
-                                 "MinX", DoubleValue (0.0),
-                                 "MinY", DoubleValue (0.0),
-                                 "DeltaX", DoubleValue (5.0),
-                                 "DeltaY", DoubleValue (10.0),
-                                 "GridWidth", UintegerValue (3),
-                                 "LayoutType", StringValue ("RowFirst"));
+  //Notice that n1 at p2pNodes is added as the 0th node at csmaNodes set
+  NodeContainer csmaNodes;
+  csmaNodes.Create (3);
 
-  //RandomWalk2dMobilityModel: the nodes move in a random direction at a random speed around inside a bounding box
-  mobility3.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
-  mobility3.Install (wifiStaNodes3);
+  CsmaHelper csma;
+  csma.SetChannelAttribute ("DataRate", StringValue ("100Mbps"));
+  csma.SetChannelAttribute ("Delay", TimeValue (NanoSeconds (6560)));
 
-  //Another mobility model used for Access Point: fixed position
-  mobility3.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
-  mobility3.Install (wifiApNode3);
+  NetDeviceContainer csmaDevices;
+  csmaDevices = csma.Install (csmaNodes);
   
-
+  Cell cell = BuildCell (csmaNodes.Get (0), "ns-3-ssid");
+  Cell cell2 = BuildCell (csmaNodes.Get (1), "ns-3-ssid-2");
+  Cell cell3 = BuildCell (csmaNodes.Get (2), "ns-3-ssid-3");
 
   // Notice that there is no return. When we have A.Install (B), we will change object B with methods in A.
   // stack.Install is used to glu previous protocol layers together at the node.
   InternetStackHelper stack;
-  stack.Install (wifiApNode);
-  stack.Install (wifiStaNodes);
+  stack.Install (cell.apNode);
+  stack.Install (cell.staNodes);
   //stack.Install (csmaNodes.Get(1));
   //stack.Install (csmaNodes.Get(2));
-  stack.Install (wifiApNode2);
-  stack.Install (wifiStaNodes2);
-  stack.Install (wifiApNode3);
-  stack.Install (wifiStaNodes3);
+  stack.Install (cell2.apNode);
+  stack.Install (cell2.staNodes);
+  stack.Install (cell3.apNode);
+  stack.Install (cell3.staNodes);
 
 
   Ipv4AddressHelper address, address2;
@@ -306,54 +234,98 @@ main (int argc, char *argv[])
 
   // Line for A
   address.SetBase ("10.1.2.0", "255.255.255.0");
-  address.Assign (staDevices);
-  address.Assign (apDevices);
+  address.Assign (cell.staDevices);
+  address.Assign (cell.apDevices);
   
   // Line for B 
   address.SetBase ("10.1.3.0", "255.255.255.0");
-  address.Assign (staDevices2);
-  address.Assign (apDevices2);
+  address.Assign (cell2.staDevices);
+  address.Assign (cell2.apDevices);
   
   // Line for C
   address2.SetBase ("10.1.4.0", "255.255.255.0");
-  address2.Assign (staDevices3);
-  address2.Assign (apDevices3);
+  address2.Assign (cell3.staDevices);
+  address2.Assign (cell3.apDevices);
 
   UdpEchoServerHelper echoServer (9);
 
-  ApplicationContainer serverApps = echoServer.Install (wifiApNode.Get (0));
+  ApplicationContainer serverApps = echoServer.Install (cell.apNode.Get (0));
   serverApps.Start (Seconds (1.0));
   serverApps.Stop (Seconds (10.0));
 
-  UdpEchoClientHelper echoClient (csmaInterfaces.GetAddress(0), 9);
+  UdpEchoRttClientHelper echoClient (csmaInterfaces.GetAddress(0), 9, rtt);
   echoClient.SetAttribute ("MaxPackets", UintegerValue (5));
   echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
   echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
 
   ApplicationContainer clientApps = 
-    echoClient.Install (wifiStaNodes2.Get (0));
+    echoClient.Install (cell2.staNodes.Get (0));
   clientApps.Start (Seconds (2.0));
   clientApps.Stop (Seconds (10.0));
 
   // Set the global routing because the packets have to be routed to the dentination.
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  SpfRoutingHelper spf;
+  Ipv4OnDemandRoutingHelper onDemand;
+  if (routing == "spf")
+    {
+      spf.Populate ();
+    }
+  else if (routing == "global")
+    {
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
+  else if (routing == "on-demand")
+    {
+      onDemand.InstallAll ();
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown routing \"" << routing << "\"");
+    }
 
   // wireless access point to generate beacons. It will generate beacons forever
+  // (--autoStop ends the run earlier once the echo traffic is over)
   Simulator::Stop (Seconds (10.0));
 
-  phy.EnablePcap ("third", apDevices.Get (0));
-  phy2.EnablePcap ("third2", apDevices2.Get (0));
-  
-  csma.EnablePcap ("third", csmaDevices.Get (0), true);
+  if (tracing)
+    {
+      cell.phy.EnablePcap ("third", cell.apDevices.Get (0));
+      cell2.phy.EnablePcap ("third2", cell2.apDevices.Get (0));
+      csma.EnablePcap ("third", csmaDevices.Get (0), true);
+    }
 
   //std::ostringstream oss;
   //oss <<
-  //"/NodeList/" << wifiStaNodes.Get (0)->GetId () <<
+  //"/NodeList/" << cell.staNodes.Get (0)->GetId () <<
   //"/$ns3::MobilityModel/CourseChange";
     
  // Config::Connect (oss.str (), MakeCallback (&CourseChange));
   
+  QuiescenceMonitor quiescence;
+  if (autoStop)
+    {
+      quiescence.Enable ();
+    }
+
+  FlowStatsCollector flows;
+  if (!flowStats.empty ())
+    {
+      flows.Install ();
+    }
+
   Simulator::Run ();
+  if (rtt)
+    {
+      UdpEchoRttClientHelper::PrintAll (std::cout);
+    }
+  if (routing == "on-demand")
+    {
+      Ipv4OnDemandRouting::PrintStats (std::cout);
+    }
+  if (!flowStats.empty ())
+    {
+      flows.Write (flowStats);
+    }
   Simulator::Destroy ();
   return 0;
 }
@@ -49,6 +49,13 @@
 #include "ns3/applications-module.h"
 #include "ns3/network-module.h"
 
+#include "cached-propagation-models.h"
+#include "flow-stats-collector.h"
+#include "pre-associated-wifi-helper.h"
+#include "profiling-scheduler.h"
+#include "scenario-bench.h"
+#include "station-echo-sweep.h"
+
 using namespace ns3;
 NS_LOG_COMPONENT_DEFINE ("Wifi-2-nodes-fixed");
 void
@@ -84,11 +91,46 @@ main (int argc, char *argv[])
     uint32_t nWifi = 5;
     /** Change this parameter and verify the output */
     double xDistance = 116.0;
+    double forkAt = 1.5;
+    bool cachePropagation = true;
+    bool preAssociated = false;
+    uint32_t sweepJobs = 0;
+    std::string sweepParam;
+    std::string sweepValues;
+    bool tracing = false;
+    uint32_t nPackets = 0;
+    std::string benchOutput = "";
+    std::string profileEvents = "";
+    std::string flowStats = "";
+    bool rtt = false;
     
     CommandLine cmd;
     cmd.AddValue ("xDistance", "Distance between two nodes along x-axis", xDistance);
+    cmd.AddValue ("sweepParam", "Parameter swept from a warmed up snapshot: distance, packetSize or startTime", sweepParam);
+    cmd.AddValue ("sweepValues", "Comma separated values for --sweepParam", sweepValues);
+    cmd.AddValue ("sweepJobs", "Runs done at the same time by a sweep (0 = one per core)", sweepJobs);
+    cmd.AddValue ("forkAt", "Simulation time (s) at which the snapshot is taken", forkAt);
+    cmd.AddValue ("cachePropagation", "Compute loss and delay once per pair of static nodes", cachePropagation);
+    cmd.AddValue ("preAssociated", "Associate the stations at start-up and stop the beacons once they are", preAssociated);
+    cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+    cmd.AddValue ("tracing", "Write pcap files of the Wi-Fi devices", tracing);
+    cmd.AddValue ("nPackets", "Packets sent by each echo client (0 = two)", nPackets);
+    cmd.AddValue ("benchOutput", "Append wall time, events, memory and allocations of the run to this file (not with --sweepParam)", benchOutput);
+    cmd.AddValue ("profileEvents", "Write the wall time of each kind of event to this file, as folded stacks for flamegraph.pl", profileEvents);
+    cmd.AddValue ("flowStats", "Write per-flow packet, delay and jitter counters to this file (CSV, or JSON if it ends in .json)", flowStats);
+    cmd.AddValue ("rtt", "Echo clients measure round trip times into histograms, instead of logging each packet", rtt);
     
     cmd.Parse (argc,argv);
+    if (!profileEvents.empty ())
+    {
+        ProfilingScheduler::Enable (profileEvents);
+    }
+    ScenarioBench bench ("lab5", sweepParam.empty () ? benchOutput : "", argc, argv);
+    bench.SetPackets (nPackets);
+    if (!sweepParam.empty ())
+    {
+        verbose = false;
+    }
     if (verbose)
     {
         LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
@@ -104,10 +146,19 @@ main (int argc, char *argv[])
     BNode = wifiStaNodes.Get (2);
     CNode = wifiStaNodes.Get (3);
     DNode = wifiStaNodes.Get (4);
+    NodeContainer stations (ANode, BNode, CNode, DNode);
 
 
     // 2. Create channel for communication
     YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
+    if (cachePropagation)
+    {
+        // Same delay and loss models as the default; all nodes stand still,
+        // so each pair's results are worked out once and then reused
+        channel = YansWifiChannelHelper ();
+        channel.SetPropagationDelay ("ns3::CachedPropagationDelayModel");
+        channel.AddPropagationLoss ("ns3::CachedPropagationLossModel");
+    }
     YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
     phy.SetChannel (channel.Create ());
     WifiHelper wifi = WifiHelper::Default ();
@@ -117,9 +168,16 @@ main (int argc, char *argv[])
    
      // 3a. Set up MAC for base stations
     Ssid ssid = Ssid ("ns-3-ssid");
-    mac.SetType ("ns3::StaWifiMac",
-                 "Ssid", SsidValue (ssid),
-                 "ActiveProbing", BooleanValue (false));
+    if (preAssociated)
+    {
+        PreAssociatedWifiHelper::ConfigureSta (mac, ssid);
+    }
+    else
+    {
+        mac.SetType ("ns3::StaWifiMac",
+                     "Ssid", SsidValue (ssid),
+                     "ActiveProbing", BooleanValue (false));
+    }
     NetDeviceContainer ADevice;
     ADevice = wifi.Install (phy, mac, wifiStaNodes.Get (1));
     
@@ -129,12 +187,26 @@ main (int argc, char *argv[])
     DDevice = wifi.Install (phy, mac, wifiStaNodes.Get(4));
 
     // 3b. Set up MAC for AP
-    mac.SetType ("ns3::ApWifiMac",
-                 "Ssid", SsidValue (ssid),
-                 "BeaconGeneration", BooleanValue (true),
-                 "BeaconInterval", TimeValue (Seconds (5)));
+    if (preAssociated)
+    {
+        PreAssociatedWifiHelper::ConfigureAp (mac, ssid, Seconds (5));
+    }
+    else
+    {
+        mac.SetType ("ns3::ApWifiMac",
+                     "Ssid", SsidValue (ssid),
+                     "BeaconGeneration", BooleanValue (true),
+                     "BeaconInterval", TimeValue (Seconds (5)));
+    }
     NetDeviceContainer apDevice;
     apDevice = wifi.Install (phy, mac, wifiApNode);
+    if (preAssociated)
+    {
+        NetDeviceContainer staDevices (ADevice, BDevice);
+        staDevices.Add (CDevice);
+        staDevices.Add (DDevice);
+        PreAssociatedWifiHelper::StopBeaconsWhenAssociated (apDevice, staDevices);
+    }
     
     
     // 4. Set mobility of the nodes
@@ -225,32 +297,29 @@ main (int argc, char *argv[])
     serverApps2.Stop (Seconds (20.0));
     
 
-    // 7b. Create and setup applications (traffic source)
-    UdpEchoClientHelper echoClient (BInterface.GetAddress (0), 9);
-    echoClient.SetAttribute ("MaxPackets", UintegerValue (2));
-    echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
-    echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
+    StationEchoSweep echoes (2);
+    echoes.SetStations (stations);
+    echoes.SetClients (wifiStaNodes.Get (1), BInterface.GetAddress (0),
+                       wifiStaNodes.Get (3), DInterface.GetAddress (0));
+    echoes.SetRtt (rtt);
     
-    UdpEchoClientHelper echoClient2 (DInterface.GetAddress (0), 19);
-    echoClient2.SetAttribute ("MaxPackets", UintegerValue (2));
-    echoClient2.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
-    echoClient2.SetAttribute ("PacketSize", UintegerValue (1024));
-    
-
-    ApplicationContainer clientApps = echoClient.Install (wifiStaNodes.Get(1)); 
-    clientApps.Start (Seconds (2.0));
-    clientApps.Stop (Seconds (6.0));
-    
-    ApplicationContainer clientApps2 = echoClient2.Install (wifiStaNodes.Get(3)); 
-    clientApps2.Start (Seconds (12.0));
-    clientApps2.Stop (Seconds (15.0));
-    
-
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
     Simulator::Stop (Seconds (20.0));
+
+    echoes.CountReplies ();
+    if (!sweepParam.empty ())
+    {
+        echoes.Run (sweepParam, ForkSweep::ParseValues (sweepValues), forkAt, sweepJobs);
+        Simulator::Destroy ();
+        return 0;
+    }
+    echoes.InstallClients (1024, Seconds (0.0));
     
     // 8. Enable tracing (optional)
-    //phy.EnablePcapAll ("wifi-2-nodes-fixed", true);
+    if (tracing)
+    {
+        phy.EnablePcapAll ("wifi-2-nodes-fixed", true);
+    }
     
     PrintAddresses(wifiApInterface, "IP addresses of base stations");
     PrintAddresses(AInterface, "IP address of A");
@@ -260,7 +329,21 @@ main (int argc, char *argv[])
     
     PrintLocations(wifiStaNodes, "Location of nodes"); 
     
+    FlowStatsCollector flows;
+    if (!flowStats.empty ())
+    {
+        flows.Install ();
+    }
+
     Simulator::Run ();
+    if (rtt)
+    {
+        UdpEchoRttClientHelper::PrintAll (std::cout);
+    }
+    if (!flowStats.empty ())
+    {
+        flows.Write (flowStats);
+    }
     Simulator::Destroy ();
     
     return 0;
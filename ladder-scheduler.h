@@ -0,0 +1,319 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+#include "ns3/core-module.h"
+#include "ns3/scheduler.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Ladder queue event scheduler (Tang, Goh and Thng, 2005), with O(1)
+ * amortized insertion and removal of the next event.
+ *
+ * Events far in the future are appended unsorted to Top.  When the near
+ * future runs out, Top is spread over the buckets of a rung; the first
+ * non-empty bucket is either spread again over a finer rung, if it holds
+ * more than Threshold events, or sorted into Bottom, from which events
+ * are dequeued.  An event is inserted into the first rung whose current
+ * bucket it does not precede, or sorted into Bottom.
+ *
+ * Simulator::Cancel never reaches the scheduler; Simulator::Remove does,
+ * and searches the bucket holding the event.  With LazyRemove, a removed
+ * event is only remembered and dropped when it reaches Bottom: Remove is
+ * then one insertion into a hash set, O(1) expected, and while any
+ * removed events are pending every event reaching Bottom costs one hash
+ * lookup.
+ *
+ * Select it with --SchedulerType=ns3::LadderScheduler.
+ */
+class LadderScheduler : public Scheduler
+{
+public:
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::LadderScheduler")
+      .SetParent<Scheduler> ()
+      .AddConstructor<LadderScheduler> ()
+      .AddAttribute ("Threshold",
+                     "Events a bucket may hold before it is spread over a finer rung.",
+                     UintegerValue (50),
+                     MakeUintegerAccessor (&LadderScheduler::m_threshold),
+                     MakeUintegerChecker<uint32_t> (1))
+      .AddAttribute ("MaxRungs",
+                     "Rungs below Top; deeper buckets are sorted whatever their size.",
+                     UintegerValue (8),
+                     MakeUintegerAccessor (&LadderScheduler::m_maxRungs),
+                     MakeUintegerChecker<uint32_t> (1))
+      .AddAttribute ("LazyRemove",
+                     "Drop removed events when they are reached instead of at once.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&LadderScheduler::m_lazyRemove),
+                     MakeBooleanChecker ())
+    ;
+    return tid;
+  }
+
+  LadderScheduler ()
+    : m_threshold (50),
+      m_maxRungs (8),
+      m_lazyRemove (false),
+      m_size (0),
+      m_topMin (0),
+      m_topMax (0),
+      m_topStart (0)
+  {
+    // Sized up front, so that the few removals usually pending never rehash
+    m_removed.reserve (1024);
+  }
+
+  virtual void
+  Insert (const Event &ev)
+  {
+    ++m_size;
+    Place (ev);
+    Refill ();
+  }
+
+  virtual bool
+  IsEmpty (void) const
+  {
+    return m_size == 0;
+  }
+
+  virtual Event
+  PeekNext (void) const
+  {
+    NS_ASSERT (!m_bottom.empty ());
+    return m_bottom.back ();
+  }
+
+  virtual Event
+  RemoveNext (void)
+  {
+    NS_ASSERT (!m_bottom.empty ());
+    Event next = m_bottom.back ();
+    m_bottom.pop_back ();
+    --m_size;
+    Refill ();
+    return next;
+  }
+
+  virtual void
+  Remove (const Event &ev)
+  {
+    --m_size;
+    if (m_lazyRemove)
+      {
+        m_removed.insert (ev.key.m_uid);
+      }
+    else
+      {
+        Erase (ev);
+      }
+    Refill ();
+  }
+
+private:
+  struct Rung
+  {
+    uint64_t start;
+    uint64_t width;
+    // Buckets before this one have been consumed
+    uint32_t current;
+    std::vector<std::vector<Event> > buckets;
+  };
+
+  static bool
+  Later (const Event &a, const Event &b)
+  {
+    return b.key < a.key;
+  }
+
+  static uint64_t
+  CurrentStart (const Rung &r)
+  {
+    return r.start + r.current * r.width;
+  }
+
+  void
+  Place (const Event &ev)
+  {
+    uint64_t ts = ev.key.m_ts;
+    if (m_top.empty () && m_rungs.empty () && m_bottom.empty ())
+      {
+        m_topStart = 0;
+      }
+    if (ts >= m_topStart)
+      {
+        if (m_top.empty ())
+          {
+            m_topMin = m_topMax = ts;
+          }
+        m_topMin = std::min (m_topMin, ts);
+        m_topMax = std::max (m_topMax, ts);
+        m_top.push_back (ev);
+        return;
+      }
+    for (std::vector<Rung>::iterator r = m_rungs.begin (); r != m_rungs.end (); ++r)
+      {
+        if (ts >= CurrentStart (*r))
+          {
+            uint64_t b = std::min<uint64_t> ((ts - r->start) / r->width, r->buckets.size () - 1);
+            r->buckets[b].push_back (ev);
+            return;
+          }
+      }
+    // Bottom is kept in decreasing order, the next event last.
+    m_bottom.insert (std::upper_bound (m_bottom.begin (), m_bottom.end (), ev, &LadderScheduler::Later), ev);
+  }
+
+  /**
+   * Spreads events over a new rung of buckets of width starting at start,
+   * enough of them to reach end.
+   */
+  void
+  Spawn (std::vector<Event> &events, uint64_t start, uint64_t end, uint64_t width)
+  {
+    Rung r;
+    r.start = start;
+    r.width = width;
+    r.current = 0;
+    r.buckets.resize ((end - start) / width + 1);
+    for (std::vector<Event>::const_iterator e = events.begin (); e != events.end (); ++e)
+      {
+        r.buckets[(e->key.m_ts - start) / width].push_back (*e);
+      }
+    events.clear ();
+    m_rungs.push_back (r);
+  }
+
+  /**
+   * Makes sure Bottom holds the next event, unless the queue is empty.
+   */
+  void
+  Refill (void)
+  {
+    while (true)
+      {
+        while (!m_bottom.empty () && !m_removed.empty () && m_removed.erase (m_bottom.back ().key.m_uid) != 0)
+          {
+            m_bottom.pop_back ();
+          }
+        if (!m_bottom.empty () || (m_rungs.empty () && m_top.empty ()))
+          {
+            return;
+          }
+        if (m_rungs.empty ())
+          {
+            // A new epoch: later insertions below the current Top maximum
+            // go into the rungs.
+            uint64_t width = std::max<uint64_t> (1, (m_topMax - m_topMin) / m_top.size ());
+            m_topStart = m_topMax;
+            Spawn (m_top, m_topMin, m_topMax, width);
+          }
+        Rung &r = m_rungs.back ();
+        while (r.current < r.buckets.size () && r.buckets[r.current].empty ())
+          {
+            ++r.current;
+          }
+        if (r.current == r.buckets.size ())
+          {
+            m_rungs.pop_back ();
+            continue;
+          }
+        std::vector<Event> &bucket = r.buckets[r.current];
+        uint64_t start = CurrentStart (r);
+        ++r.current;
+        if (bucket.size () > m_threshold && r.width > 1 && m_rungs.size () < m_maxRungs)
+          {
+            uint64_t width = std::max<uint64_t> (1, r.width / bucket.size ());
+            std::vector<Event> events;
+            events.swap (bucket);
+            Spawn (events, start, start + r.width - 1, width);
+          }
+        else
+          {
+            m_bottom.swap (bucket);
+            std::sort (m_bottom.begin (), m_bottom.end (), &LadderScheduler::Later);
+          }
+      }
+  }
+
+  static bool
+  EraseFrom (std::vector<Event> &events, const Event &ev)
+  {
+    for (std::vector<Event>::iterator e = events.begin (); e != events.end (); ++e)
+      {
+        if (e->key.m_uid == ev.key.m_uid)
+          {
+            events.erase (e);
+            return true;
+          }
+      }
+    return false;
+  }
+
+  void
+  Erase (const Event &ev)
+  {
+    if (EraseFrom (m_bottom, ev))
+      {
+        return;
+      }
+    for (std::vector<Rung>::iterator r = m_rungs.begin (); r != m_rungs.end (); ++r)
+      {
+        uint64_t ts = ev.key.m_ts;
+        if (ts >= r->start)
+          {
+            uint64_t b = std::min<uint64_t> ((ts - r->start) / r->width, r->buckets.size () - 1);
+            if (EraseFrom (r->buckets[b], ev))
+              {
+                return;
+              }
+          }
+      }
+    bool found = EraseFrom (m_top, ev);
+    NS_ASSERT_MSG (found, "LadderScheduler::Remove (): event " << ev.key.m_uid << " is not queued");
+  }
+
+  uint32_t m_threshold;
+  uint32_t m_maxRungs;
+  bool m_lazyRemove;
+  // Events queued, not counting those removed lazily
+  uint32_t m_size;
+  std::vector<Event> m_top;
+  uint64_t m_topMin;
+  uint64_t m_topMax;
+  // Events at least this late go into Top
+  uint64_t m_topStart;
+  std::vector<Rung> m_rungs;
+  std::vector<Event> m_bottom;
+  std::unordered_set<uint32_t> m_removed;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (LadderScheduler);
+
+} // namespace ns3
+
+#endif /* LADDER_SCHEDULER_H */
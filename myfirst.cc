@@ -20,6 +20,12 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 
+#include "async-pcap-helper.h"
+#include "binary-trace-helper.h"
+#include "flow-stats-collector.h"
+#include "profiling-scheduler.h"
+#include "scenario-bench.h"
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("FirstScriptExample");
@@ -27,8 +33,37 @@ NS_LOG_COMPONENT_DEFINE ("FirstScriptExample");
 int
 main (int argc, char *argv[])
 {
-  LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
-  LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
+  bool verbose = true;
+  std::string traceFormat = "ascii";
+  bool tracing = true;
+  uint32_t nPackets = 0;
+  std::string benchOutput = "";
+  std::string profileEvents = "";
+  std::string flowStats = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+  cmd.AddValue ("traceFormat", "Format of the device trace: ascii (myfirst.tr) or binary (myfirst.btr, "
+                "see binary-trace-to-ascii)", traceFormat);
+  cmd.AddValue ("tracing", "Write the device trace and the pcap files", tracing);
+  cmd.AddValue ("nPackets", "Packets sent by each echo client (0 = one)", nPackets);
+  cmd.AddValue ("benchOutput", "Append wall time, events, memory and allocations of the run to this file", benchOutput);
+  cmd.AddValue ("profileEvents", "Write the wall time of each kind of event to this file, as folded stacks for flamegraph.pl", profileEvents);
+  cmd.AddValue ("flowStats", "Write per-flow packet, delay and jitter counters to this file (CSV, or JSON if it ends in .json)", flowStats);
+  cmd.Parse (argc, argv);
+
+  if (!profileEvents.empty ())
+    {
+      ProfilingScheduler::Enable (profileEvents);
+    }
+  ScenarioBench bench ("myfirst", benchOutput, argc, argv);
+  bench.SetPackets (nPackets);
+
+  if (verbose)
+    {
+      LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
+      LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
+    }
  
   NodeContainer nodes;
   nodes.Create (2);
@@ -97,10 +132,40 @@ main (int argc, char *argv[])
   clientA.Start (Seconds (2.0));
   clientA.Stop (Seconds (15.0));
   
-  AsciiTraceHelper ascii;
-  pointToPoint.EnableAsciiAll (ascii.CreateFileStream ("myfirst.tr"));
-  pointToPoint.EnablePcapAll ("myfirst"); 
+  BinaryTraceHelper binary;
+  AsyncPcapHelper pcap;
+  if (tracing)
+    {
+      if (traceFormat == "binary")
+        {
+          binary.Open ("myfirst.btr");
+          binary.EnableAll ();
+        }
+      else if (traceFormat == "ascii")
+        {
+          AsciiTraceHelper ascii;
+          pointToPoint.EnableAsciiAll (ascii.CreateFileStream ("myfirst.tr"));
+        }
+      else
+        {
+          NS_FATAL_ERROR ("Unknown trace format \"" << traceFormat << "\"");
+        }
+      // Same files as pointToPoint.EnablePcapAll, written by a background thread
+      pcap.EnablePcapAll<PointToPointNetDevice> ("myfirst");
+    }
+  FlowStatsCollector flows;
+  if (!flowStats.empty ())
+    {
+      flows.Install ();
+    }
+
   Simulator::Run ();
+  pcap.Close ();
+  binary.Close ();
+  if (!flowStats.empty ())
+    {
+      flows.Write (flowStats);
+    }
   Simulator::Destroy ();
   return 0;
 }
@@ -22,6 +22,17 @@
 #include "ns3/applications-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
 
+#include "async-pcap-helper.h"
+#include "echo-stack-helper.h"
+#include "flow-stats-collector.h"
+#include "ipv4-on-demand-routing.h"
+#include "ladder-scheduler.h"
+#include "recording-scheduler.h"
+#include "profiling-scheduler.h"
+#include "scenario-bench.h"
+#include "spf-routing-helper.h"
+#include "static-arp-helper.h"
+
 // Default Network Topology
 //
 //       10.1.1.0
@@ -40,13 +51,56 @@ main (int argc, char *argv[])
 {
   bool verbose = true;
   uint32_t nCsma = 3;
+  std::string pcapCompression = "none";
+  std::string pcapFilter = "";
+  uint32_t snapLen = 65535;
+  std::string routing = "global";
+  std::string stackProfile = "full";
+  bool stackFootprint = false;
+  bool staticArp = false;
+  std::string recordEvents = "";
+  bool tracing = true;
+  uint32_t nPackets = 0;
+  std::string benchOutput = "";
+  std::string profileEvents = "";
+  std::string flowStats = "";
 
   CommandLine cmd;
   cmd.AddValue ("nCsma", "Number of \"extra\" CSMA nodes/devices", nCsma);
   cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+  cmd.AddValue ("pcapCompression", "Compress pcap files while writing them: none, gzip or zstd", pcapCompression);
+  cmd.AddValue ("pcapFilter", "Only capture packets matching this tcpdump-style filter, e.g. \"udp port 9\"", pcapFilter);
+  cmd.AddValue ("snapLen", "Bytes of each packet kept in the pcap files", snapLen);
+  cmd.AddValue ("routing", "How routes are computed: global (Ipv4GlobalRoutingHelper), spf (parallel SpfRoutingHelper) or on-demand (first use, cached per node)", routing);
+  cmd.AddValue ("stack", "Protocols installed on each node: full (InternetStackHelper) or echo (IPv4, ARP, ICMP and UDP only)", stackProfile);
+  cmd.AddValue ("stackFootprint", "Print the objects and memory taken by the protocol stacks (always done for --stack=echo)", stackFootprint);
+  cmd.AddValue ("staticArp", "Fill ARP caches from the address assignments instead of resolving on the bus", staticArp);
+  cmd.AddValue ("recordEvents", "Log every event queue operation to this file, for scheduler-benchmark", recordEvents);
+  cmd.AddValue ("tracing", "Write the pcap files", tracing);
+  cmd.AddValue ("nPackets", "Packets sent by the echo client (0 = one)", nPackets);
+  cmd.AddValue ("benchOutput", "Append wall time, events, memory and allocations of the run to this file", benchOutput);
+  cmd.AddValue ("profileEvents", "Write the wall time of each kind of event to this file, as folded stacks for flamegraph.pl", profileEvents);
+  cmd.AddValue ("flowStats", "Write per-flow packet, delay and jitter counters to this file (CSV, or JSON if it ends in .json)", flowStats);
 
   cmd.Parse (argc,argv);
 
+  if (!recordEvents.empty ())
+    {
+      RecordingScheduler::Enable (recordEvents);
+    }
+  if (!profileEvents.empty ())
+    {
+      ProfilingScheduler::Enable (profileEvents);
+    }
+  bool printFootprint = stackFootprint || stackProfile != "full";
+  if (printFootprint)
+    {
+      // Before ScenarioBench, which may turn on the slab allocator
+      AllocStats::EnableCounting ();
+    }
+  ScenarioBench bench ("mysecond", benchOutput, argc, argv);
+  bench.SetPackets (nPackets);
+
   if (verbose)
     {
       LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
@@ -76,9 +130,27 @@ main (int argc, char *argv[])
   NetDeviceContainer csmaDevices;
   csmaDevices = csma.Install (csmaNodes);
 
-  InternetStackHelper stack;
-  stack.Install (p2pNodes.Get (0));
-  stack.Install (csmaNodes);
+  NodeContainer allNodes (p2pNodes.Get (0), csmaNodes);
+  uint64_t stackBytes = AllocStats::Get ().bytes;
+  if (stackProfile == "echo")
+    {
+      EchoStackHelper stack;
+      stack.Install (allNodes);
+    }
+  else if (stackProfile == "full")
+    {
+      InternetStackHelper stack;
+      stack.Install (allNodes);
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown stack \"" << stackProfile << "\"");
+    }
+  stackBytes = AllocStats::Get ().bytes - stackBytes;
+  if (printFootprint)
+    {
+      EchoStackHelper::PrintFootprint (std::cout, stackProfile, allNodes, stackBytes);
+    }
 
   Ipv4AddressHelper address;
   address.SetBase ("10.1.1.0", "255.255.255.0");
@@ -89,6 +161,16 @@ main (int argc, char *argv[])
   Ipv4InterfaceContainer csmaInterfaces;
   csmaInterfaces = address.Assign (csmaDevices);
 
+  if (staticArp)
+    {
+      // Only the gateway and the echo server talk on the bus, so the
+      // other nodes need not learn each other.
+      Ipv4InterfaceContainer talkers;
+      talkers.Add (csmaInterfaces.Get (0));
+      talkers.Add (csmaInterfaces.Get (nCsma));
+      StaticArpHelper::Populate (csmaInterfaces, talkers);
+    }
+
   UdpEchoServerHelper echoServer (9);
 
   ApplicationContainer serverApps = echoServer.Install (csmaNodes.Get (nCsma));
@@ -104,13 +186,53 @@ main (int argc, char *argv[])
   clientApps.Start (Seconds (2.0));
   clientApps.Stop (Seconds (10.0));
 
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  SpfRoutingHelper spf;
+  Ipv4OnDemandRoutingHelper onDemand;
+  if (routing == "spf")
+    {
+      spf.Populate ();
+    }
+  else if (routing == "global")
+    {
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
+  else if (routing == "on-demand")
+    {
+      onDemand.InstallAll ();
+    }
+  else
+    {
+      NS_FATAL_ERROR ("Unknown routing \"" << routing << "\"");
+    }
 
-  pointToPoint.EnablePcap ("second", p2pNodes.Get (0)->GetId (), 0);
-  csma.EnablePcap ("second", csmaNodes.Get (nCsma)->GetId (), 0, false);
-  csma.EnablePcap ("second", csmaNodes.Get (nCsma-1)->GetId (), 0, false);
+  // Same captures as pointToPoint.EnablePcap and csma.EnablePcap, written
+  // (and optionally compressed) off the simulator thread
+  AsyncPcapHelper pcap (1 << 20, AsyncPcapHelper::ParseCompression (pcapCompression));
+  if (tracing)
+    {
+      pcap.SetSnapLen (snapLen);
+      pcap.SetFilter (pcapFilter);
+      pcap.EnablePcap ("second", p2pNodes.Get (0)->GetId (), 0);
+      pcap.EnablePcap ("second", csmaNodes.Get (nCsma)->GetId (), 0, false);
+      pcap.EnablePcap ("second", csmaNodes.Get (nCsma-1)->GetId (), 0, false);
+    }
   
+  FlowStatsCollector flows;
+  if (!flowStats.empty ())
+    {
+      flows.Install ();
+    }
+
   Simulator::Run ();
+  if (routing == "on-demand")
+    {
+      Ipv4OnDemandRouting::PrintStats (std::cout);
+    }
+  pcap.Close ();
+  if (!flowStats.empty ())
+    {
+      flows.Write (flowStats);
+    }
   Simulator::Destroy ();
   return 0;
 }
@@ -0,0 +1,443 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PACKET_FILTER_H
+#define PACKET_FILTER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Capture filter for a subset of the tcpdump/BPF expression language:
+ *
+ *   ip, arp, icmp, tcp, udp
+ *   [src|dst] host A.B.C.D
+ *   [src|dst] port N
+ *   not/!, and/&&, or/||, parentheses; juxtaposition means and
+ *
+ * e.g. "udp port 9" or "arp or (tcp and not port 22)".  The expression is
+ * compiled once; matching looks only at the first MAX_HEADER bytes of a
+ * frame, which are copied onto the stack, so a rejected packet is never
+ * serialized or copied any further.  Frames are PPP (as sent by
+ * PointToPointNetDevice) or Ethernet II (CsmaNetDevice).
+ */
+class PacketFilter
+{
+public:
+  /// Bytes of a frame the filter can look at
+  static const uint32_t MAX_HEADER = 128;
+
+  /**
+   * A filter matching every packet.
+   */
+  PacketFilter ()
+    : m_root (0),
+      m_next (0)
+  {
+  }
+
+  /**
+   * Compiles expression; an empty expression matches every packet.
+   */
+  PacketFilter (std::string expression)
+    : m_expression (expression),
+      m_root (0),
+      m_next (0)
+  {
+    Tokenize (expression);
+    if (!m_tokens.empty ())
+      {
+        m_root = ParseOr ();
+        if (m_next != m_tokens.size ())
+          {
+            Fail ("unexpected \"" + m_tokens[m_next] + "\"");
+          }
+      }
+    m_tokens.clear ();
+  }
+
+  bool
+  IsEmpty (void) const
+  {
+    return m_nodes.empty ();
+  }
+
+  std::string
+  GetExpression (void) const
+  {
+    return m_expression;
+  }
+
+  bool
+  Matches (Ptr<const Packet> p, uint32_t dataLinkType) const
+  {
+    if (IsEmpty ())
+      {
+        return true;
+      }
+    uint8_t data[MAX_HEADER];
+    uint32_t length = p->CopyData (data, MAX_HEADER);
+    return Matches (data, length, dataLinkType);
+  }
+
+  bool
+  Matches (const uint8_t *data, uint32_t length, uint32_t dataLinkType) const
+  {
+    if (IsEmpty ())
+      {
+        return true;
+      }
+    Fields fields;
+    Decode (data, length, dataLinkType, fields);
+    return Evaluate (m_root, fields);
+  }
+
+private:
+  enum Kind
+  {
+    AND,
+    OR,
+    NOT,
+    IP,
+    ARP,
+    PROTOCOL,
+    HOST,
+    PORT
+  };
+
+  enum Direction
+  {
+    EITHER,
+    SRC,
+    DST
+  };
+
+  struct Node
+  {
+    Kind kind;
+    Direction direction;
+    uint32_t value;
+    uint32_t left;
+    uint32_t right;
+  };
+
+  // What the filter primitives need to know about a frame
+  struct Fields
+  {
+    bool ip;
+    bool arp;
+    uint8_t protocol;
+    uint32_t src;
+    uint32_t dst;
+    bool ports;
+    uint16_t srcPort;
+    uint16_t dstPort;
+  };
+
+  static uint16_t
+  Read16 (const uint8_t *p)
+  {
+    return (p[0] << 8) | p[1];
+  }
+
+  static uint32_t
+  Read32 (const uint8_t *p)
+  {
+    return (uint32_t (p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+  }
+
+  static void
+  Decode (const uint8_t *d, uint32_t length, uint32_t dataLinkType, Fields &f)
+  {
+    f.ip = false;
+    f.arp = false;
+    f.ports = false;
+    uint32_t o;
+    uint16_t type;
+    if (dataLinkType == PcapHelper::DLT_PPP && length >= 2)
+      {
+        o = 2;
+        type = Read16 (d) == 0x0021 ? 0x0800 : 0;
+      }
+    else if (dataLinkType == PcapHelper::DLT_EN10MB && length >= 14)
+      {
+        o = 14;
+        type = Read16 (d + 12);
+      }
+    else
+      {
+        return;
+      }
+
+    if (type == 0x0800 && length >= o + 20 && (d[o] >> 4) == 4)
+      {
+        f.ip = true;
+        f.protocol = d[o + 9];
+        f.src = Read32 (d + o + 12);
+        f.dst = Read32 (d + o + 16);
+        uint32_t l4 = o + (d[o] & 0x0f) * 4;
+        bool firstFragment = (Read16 (d + o + 6) & 0x1fff) == 0;
+        if (firstFragment && (f.protocol == 6 || f.protocol == 17) && length >= l4 + 4)
+          {
+            f.ports = true;
+            f.srcPort = Read16 (d + l4);
+            f.dstPort = Read16 (d + l4 + 2);
+          }
+      }
+    else if (type == 0x0806 && length >= o + 28)
+      {
+        // Sender and target protocol addresses of an Ethernet/IPv4 ARP
+        f.arp = true;
+        f.src = Read32 (d + o + 14);
+        f.dst = Read32 (d + o + 24);
+      }
+  }
+
+  static bool
+  Compare (Direction direction, uint32_t value, uint32_t src, uint32_t dst)
+  {
+    return (direction != DST && src == value) || (direction != SRC && dst == value);
+  }
+
+  bool
+  Evaluate (uint32_t i, const Fields &f) const
+  {
+    const Node &n = m_nodes[i];
+    switch (n.kind)
+      {
+      case AND:
+        return Evaluate (n.left, f) && Evaluate (n.right, f);
+      case OR:
+        return Evaluate (n.left, f) || Evaluate (n.right, f);
+      case NOT:
+        return !Evaluate (n.left, f);
+      case IP:
+        return f.ip;
+      case ARP:
+        return f.arp;
+      case PROTOCOL:
+        return f.ip && f.protocol == n.value;
+      case HOST:
+        return (f.ip || f.arp) && Compare (n.direction, n.value, f.src, f.dst);
+      case PORT:
+        return f.ports && Compare (n.direction, n.value, f.srcPort, f.dstPort);
+      }
+    return false;
+  }
+
+  void
+  Tokenize (std::string s)
+  {
+    std::string token;
+    for (std::string::size_type i = 0; i <= s.size (); ++i)
+      {
+        char c = i < s.size () ? s[i] : ' ';
+        bool single = c == '(' || c == ')' || (c == '!' && (i + 1 >= s.size () || s[i + 1] != '='));
+        if (c == ' ' || c == '\t' || single)
+          {
+            if (!token.empty ())
+              {
+                m_tokens.push_back (token);
+                token.clear ();
+              }
+            if (single)
+              {
+                m_tokens.push_back (std::string (1, c));
+              }
+          }
+        else
+          {
+            token += c;
+          }
+      }
+  }
+
+  void
+  Fail (std::string what) const
+  {
+    NS_FATAL_ERROR ("Bad packet filter \"" << m_expression << "\": " << what);
+  }
+
+  bool
+  Accept (std::string a, std::string b = "")
+  {
+    if (m_next < m_tokens.size () && (m_tokens[m_next] == a || (!b.empty () && m_tokens[m_next] == b)))
+      {
+        ++m_next;
+        return true;
+      }
+    return false;
+  }
+
+  std::string
+  Take (std::string what)
+  {
+    if (m_next >= m_tokens.size ())
+      {
+        Fail ("expected " + what + " at the end");
+      }
+    return m_tokens[m_next++];
+  }
+
+  uint32_t
+  Add (Kind kind, Direction direction = EITHER, uint32_t value = 0, uint32_t left = 0, uint32_t right = 0)
+  {
+    Node n;
+    n.kind = kind;
+    n.direction = direction;
+    n.value = value;
+    n.left = left;
+    n.right = right;
+    m_nodes.push_back (n);
+    return m_nodes.size () - 1;
+  }
+
+  uint32_t
+  ParseOr (void)
+  {
+    uint32_t left = ParseAnd ();
+    while (Accept ("or", "||"))
+      {
+        left = Add (OR, EITHER, 0, left, ParseAnd ());
+      }
+    return left;
+  }
+
+  uint32_t
+  ParseAnd (void)
+  {
+    uint32_t left = ParseUnary ();
+    while (Accept ("and", "&&") || StartsTerm ())
+      {
+        left = Add (AND, EITHER, 0, left, ParseUnary ());
+      }
+    return left;
+  }
+
+  // As in tcpdump, "udp port 9" means "udp and port 9".
+  bool
+  StartsTerm (void) const
+  {
+    if (m_next >= m_tokens.size ())
+      {
+        return false;
+      }
+    const std::string &t = m_tokens[m_next];
+    return t != "or" && t != "||" && t != ")";
+  }
+
+  uint32_t
+  ParseUnary (void)
+  {
+    if (Accept ("not", "!"))
+      {
+        return Add (NOT, EITHER, 0, ParseUnary ());
+      }
+    if (Accept ("("))
+      {
+        uint32_t inner = ParseOr ();
+        if (!Accept (")"))
+          {
+            Fail ("missing \")\"");
+          }
+        return inner;
+      }
+    return ParsePrimitive ();
+  }
+
+  uint32_t
+  ParsePrimitive (void)
+  {
+    Direction direction = EITHER;
+    if (Accept ("src"))
+      {
+        direction = SRC;
+      }
+    else if (Accept ("dst"))
+      {
+        direction = DST;
+      }
+
+    std::string word = Take ("a primitive");
+    if (word == "host")
+      {
+        std::string address = Take ("an address");
+        unsigned a, b, c, d;
+        char extra;
+        if (std::sscanf (address.c_str (), "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4
+            || a > 255 || b > 255 || c > 255 || d > 255)
+          {
+            Fail ("\"" + address + "\" is not an IPv4 address");
+          }
+        return Add (HOST, direction, (a << 24) | (b << 16) | (c << 8) | d);
+      }
+    if (word == "port")
+      {
+        std::string port = Take ("a port");
+        char *end;
+        unsigned long value = std::strtoul (port.c_str (), &end, 10);
+        if (*end != '\0' || port.empty () || value > 65535)
+          {
+            Fail ("\"" + port + "\" is not a port");
+          }
+        return Add (PORT, direction, value);
+      }
+    if (direction != EITHER)
+      {
+        Fail ("src/dst must be followed by host or port");
+      }
+    if (word == "ip")
+      {
+        return Add (IP);
+      }
+    if (word == "arp")
+      {
+        return Add (ARP);
+      }
+    if (word == "icmp")
+      {
+        return Add (PROTOCOL, EITHER, 1);
+      }
+    if (word == "tcp")
+      {
+        return Add (PROTOCOL, EITHER, 6);
+      }
+    if (word == "udp")
+      {
+        return Add (PROTOCOL, EITHER, 17);
+      }
+    Fail ("unknown primitive \"" + word + "\"");
+    return 0;
+  }
+
+  std::string m_expression;
+  std::vector<Node> m_nodes;
+  uint32_t m_root;
+  // Only used while compiling
+  std::vector<std::string> m_tokens;
+  uint32_t m_next;
+};
+
+} // namespace ns3
+
+#endif /* PACKET_FILTER_H */
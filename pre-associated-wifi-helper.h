@@ -0,0 +1,134 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PRE_ASSOCIATED_WIFI_HELPER_H
+#define PRE_ASSOCIATED_WIFI_HELPER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Infrastructure Wi-Fi for static scenarios: stations are associated
+ * within a few milliseconds of the start and the AP is silent afterwards.
+ *
+ * StaWifiMac offers no way to start out associated, so the AP sends its
+ * first beacon at time zero (no jitter), each station associates on it,
+ * and once every station has done so the AP stops generating beacons.
+ * Stations are told to tolerate a practically unlimited number of missed
+ * beacons, so they never fall back to scanning.  A station that fails to
+ * associate (e.g. out of range) keeps the beacons going, as usual.
+ *
+ * Usage: configure the MAC helper with ConfigureSta and ConfigureAp
+ * instead of SetType, install the devices, then call
+ * StopBeaconsWhenAssociated.
+ */
+class PreAssociatedWifiHelper
+{
+public:
+  /// Beacons a station may miss before it looks for another AP
+  static const uint32_t MAX_MISSED_BEACONS = 1000000;
+
+  static void
+  ConfigureSta (NqosWifiMacHelper &mac, Ssid ssid)
+  {
+    mac.SetType ("ns3::StaWifiMac",
+                 "Ssid", SsidValue (ssid),
+                 "ActiveProbing", BooleanValue (false),
+                 "MaxMissedBeacons", UintegerValue (MAX_MISSED_BEACONS));
+  }
+
+  static void
+  ConfigureAp (NqosWifiMacHelper &mac, Ssid ssid, Time beaconInterval)
+  {
+    mac.SetType ("ns3::ApWifiMac",
+                 "Ssid", SsidValue (ssid),
+                 "BeaconGeneration", BooleanValue (true),
+                 "BeaconInterval", TimeValue (beaconInterval),
+                 "EnableBeaconJitter", BooleanValue (false));
+  }
+
+  /**
+   * Turns the beacons of the APs off once every station of stas has
+   * associated.
+   */
+  static void
+  StopBeaconsWhenAssociated (NetDeviceContainer aps, NetDeviceContainer stas)
+  {
+    Ptr<Pending> pending = Create<Pending> ();
+    for (NetDeviceContainer::Iterator i = aps.Begin (); i != aps.End (); ++i)
+      {
+        Ptr<ApWifiMac> mac = GetMac<ApWifiMac> (*i);
+        NS_ABORT_MSG_IF (mac == 0, "PreAssociatedWifiHelper: not an AP device");
+        pending->aps.push_back (mac);
+      }
+    pending->associated.resize (stas.GetN (), false);
+    pending->remaining = stas.GetN ();
+    for (uint32_t i = 0; i < stas.GetN (); ++i)
+      {
+        Ptr<StaWifiMac> mac = GetMac<StaWifiMac> (stas.Get (i));
+        NS_ABORT_MSG_IF (mac == 0, "PreAssociatedWifiHelper: not a station device");
+        mac->TraceConnectWithoutContext ("Assoc", MakeBoundCallback (&PreAssociatedWifiHelper::Associated, pending, i));
+      }
+  }
+
+private:
+  struct Pending : public SimpleRefCount<Pending>
+  {
+    std::vector<Ptr<ApWifiMac> > aps;
+    std::vector<bool> associated;
+    uint32_t remaining;
+  };
+
+  template <typename T>
+  static Ptr<T>
+  GetMac (Ptr<NetDevice> device)
+  {
+    Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice> (device);
+    if (wifi == 0)
+      {
+        return 0;
+      }
+    return DynamicCast<T> (wifi->GetMac ());
+  }
+
+  static void
+  Associated (Ptr<Pending> pending, uint32_t station, Mac48Address ap)
+  {
+    if (pending->associated[station])
+      {
+        return;
+      }
+    pending->associated[station] = true;
+    if (--pending->remaining == 0)
+      {
+        for (uint32_t i = 0; i < pending->aps.size (); ++i)
+          {
+            pending->aps[i]->SetAttribute ("BeaconGeneration", BooleanValue (false));
+          }
+      }
+  }
+};
+
+const uint32_t PreAssociatedWifiHelper::MAX_MISSED_BEACONS;
+
+} // namespace ns3
+
+#endif /* PRE_ASSOCIATED_WIFI_HELPER_H */
@@ -0,0 +1,333 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PROFILING_SCHEDULER_H
+#define PROFILING_SCHEDULER_H
+
+#include "ns3/core-module.h"
+#include "ns3/scheduler.h"
+
+#include "wrapping-scheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <time.h>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Wrapping scheduler that measures the wall time of each event, by the
+ * type of its callback.
+ *
+ * DefaultSimulatorImpl takes an event off the queue with RemoveNext, runs
+ * it, and asks IsEmpty before the next one, so the time between the two
+ * calls is the event, including whatever it schedules.  Events are told
+ * apart by the dynamic type of their EventImpl: MakeEvent creates one per
+ * callback signature, which names the class of a member function but not
+ * the member itself, so methods of a class with the same signature share
+ * a line.  Timers show up as TimerImpl.
+ *
+ * When Simulator::Destroy is called, Filename gets the profile as folded
+ * stacks (run;category;class;callback nanoseconds), which flamegraph.pl
+ * and speedscope read; Filename.counts has the same stacks with event
+ * counts, and the heaviest lines are printed.  The category is guessed
+ * from the class name: application, device, protocol, mobility or core.
+ *
+ * The cost is two clock reads and a hash lookup per event.  The aim was
+ * to stay under 5% of the run time, but that has not been measured yet:
+ * it takes an ns-3 build, which this directory does not have.  Measure it
+ * with run-scenario-benchmarks.py, comparing a run of the suite with
+ * --profile against one without (runSeconds and eventsPerSecond).
+ */
+class ProfilingScheduler : public WrappingScheduler
+{
+public:
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = AddInnerAttribute (TypeId ("ns3::ProfilingScheduler"))
+      .SetParent<Scheduler> ()
+      .AddConstructor<ProfilingScheduler> ()
+      .AddAttribute ("Filename",
+                     "File the folded stacks are written to.",
+                     StringValue ("events.folded"),
+                     MakeStringAccessor (&ProfilingScheduler::m_filename),
+                     MakeStringChecker ())
+    ;
+    return tid;
+  }
+
+  /**
+   * Profiles the events of this run, on top of the scheduler selected so
+   * far.  Call before anything is scheduled.
+   */
+  static void
+  Enable (std::string filename)
+  {
+    if (Wrap (GetTypeId ()))
+      {
+        Config::SetDefault ("ns3::ProfilingScheduler::Filename", StringValue (filename));
+      }
+  }
+
+  ProfilingScheduler ()
+    : m_running (0),
+      m_cancelled (false),
+      m_started (0),
+      m_stopped (false)
+  {
+  }
+
+  virtual bool
+  IsEmpty (void) const
+  {
+    Finish ();
+    return WrappingScheduler::IsEmpty ();
+  }
+
+  virtual Event
+  RemoveNext (void)
+  {
+    Event next = WrappingScheduler::RemoveNext ();
+    Finish ();
+    if (m_stopped)
+      {
+        return next;
+      }
+    m_running = &typeid (*next.impl);
+    m_cancelled = next.impl->IsCancelled ();
+    m_started = GetNanoSeconds ();
+    return next;
+  }
+
+private:
+  struct Sample
+  {
+    Sample ()
+      : nanoSeconds (0),
+        events (0)
+    {
+    }
+
+    uint64_t nanoSeconds;
+    uint64_t events;
+  };
+
+  static uint64_t
+  GetNanoSeconds (void)
+  {
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+  }
+
+  virtual void
+  DoStart (void)
+  {
+    // Before the simulator drains the events left over
+    Simulator::ScheduleDestroy (&ProfilingScheduler::Stop, this);
+  }
+
+  void
+  Stop (void)
+  {
+    Finish ();
+    m_stopped = true;
+    Write ();
+  }
+
+  /**
+   * Charges the time since RemoveNext to the event it returned.
+   */
+  void
+  Finish (void) const
+  {
+    if (m_running == 0)
+      {
+        return;
+      }
+    Sample &s = m_cancelled ? m_cancelledSample : m_samples[m_running];
+    s.nanoSeconds += GetNanoSeconds () - m_started;
+    ++s.events;
+    m_running = 0;
+  }
+
+  static std::string
+  Demangle (const char *name)
+  {
+    int status;
+    char *demangled = abi::__cxa_demangle (name, 0, 0, &status);
+    if (status != 0)
+      {
+        return name;
+      }
+    std::string s = demangled;
+    std::free (demangled);
+    return s;
+  }
+
+  /**
+   * The first template argument of MakeEvent, i.e. the callback type,
+   * or an empty string if the event was not made by MakeEvent.
+   */
+  static std::string
+  GetCallbackType (const std::string &impl)
+  {
+    std::string::size_type start = impl.find ("MakeEvent<");
+    if (start == std::string::npos)
+      {
+        return "";
+      }
+    start += 10;
+    int depth = 0;
+    for (std::string::size_type i = start; i < impl.size (); ++i)
+      {
+        char c = impl[i];
+        if (c == '<' || c == '(')
+          {
+            ++depth;
+          }
+        else if ((c == '>' || c == ')') && depth > 0)
+          {
+            --depth;
+          }
+        else if ((c == ',' || c == '>') && depth == 0)
+          {
+            return impl.substr (start, i - start);
+          }
+      }
+    return "";
+  }
+
+  static std::string
+  GetCategory (const std::string &cls)
+  {
+    static const char *const applications[] = { "Application", "Client", "Server", "Sink", 0 };
+    static const char *const devices[] = { "NetDevice", "Phy", "Mac", "Channel", "Queue", "Dcf", "Dca",
+                                           "Txop", "Station", "Interference", 0 };
+    static const char *const protocols[] = { "Ipv4", "Ipv6", "Arp", "Udp", "Tcp", "Icmp", "Routing",
+                                             "Socket", "TrafficControl", 0 };
+    static const struct
+    {
+      const char *name;
+      const char *const *keywords;
+    } categories[] = { { "application", applications }, { "device", devices }, { "protocol", protocols } };
+    for (uint32_t i = 0; i < sizeof (categories) / sizeof (categories[0]); ++i)
+      {
+        for (const char *const *k = categories[i].keywords; *k != 0; ++k)
+          {
+            if (cls.find (*k) != std::string::npos)
+              {
+                return categories[i].name;
+              }
+          }
+      }
+    return cls.find ("Mobility") != std::string::npos ? "mobility" : "core";
+  }
+
+  /**
+   * Folded stack frames below the run for an event type.
+   */
+  static std::string
+  Describe (const std::type_info *type)
+  {
+    std::string impl = Demangle (type->name ());
+    std::string callback = GetCallbackType (impl);
+    if (callback.empty ())
+      {
+        return "core;" + impl;
+      }
+    std::string::size_type member = callback.find ("::*)");
+    if (member == std::string::npos)
+      {
+        return "core;function;" + callback;
+      }
+    std::string::size_type open = callback.rfind ('(', member);
+    std::string cls = callback.substr (open + 1, member - open - 1);
+    return GetCategory (cls) + ";" + cls + ";" + callback;
+  }
+
+  void
+  Write (void) const
+  {
+    std::vector<std::pair<Sample, std::string> > lines;
+    for (Samples::const_iterator i = m_samples.begin (); i != m_samples.end (); ++i)
+      {
+        lines.push_back (std::make_pair (i->second, Describe (i->first)));
+      }
+    if (m_cancelledSample.events != 0)
+      {
+        lines.push_back (std::make_pair (m_cancelledSample, std::string ("core;cancelled")));
+      }
+    // Different types may describe alike; flamegraph.pl wants each stack once.
+    std::map<std::string, Sample> stacks;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < lines.size (); ++i)
+      {
+        Sample &s = stacks[lines[i].second];
+        s.nanoSeconds += lines[i].first.nanoSeconds;
+        s.events += lines[i].first.events;
+        total += lines[i].first.nanoSeconds;
+      }
+
+    std::ofstream times (m_filename.c_str ());
+    std::ofstream counts ((m_filename + ".counts").c_str ());
+    NS_ABORT_MSG_UNLESS (times && counts, "Unable to open " << m_filename);
+    std::vector<std::pair<uint64_t, std::string> > heaviest;
+    for (std::map<std::string, Sample>::const_iterator i = stacks.begin (); i != stacks.end (); ++i)
+      {
+        times << "Simulator::Run;" << i->first << " " << i->second.nanoSeconds << "\n";
+        counts << "Simulator::Run;" << i->first << " " << i->second.events << "\n";
+        heaviest.push_back (std::make_pair (i->second.nanoSeconds, i->first));
+      }
+
+    std::sort (heaviest.rbegin (), heaviest.rend ());
+    std::cout << "Event profile written to " << m_filename << ", heaviest callbacks:" << std::endl;
+    for (uint32_t i = 0; i < std::min<uint32_t> (10, heaviest.size ()); ++i)
+      {
+        std::cout << std::fixed << std::setprecision (1) << std::setw (6)
+                  << 100.0 * heaviest[i].first / std::max<uint64_t> (total, 1) << "%  "
+                  << std::setw (10) << stacks[heaviest[i].second].events << " events  "
+                  << heaviest[i].second << std::endl;
+      }
+  }
+
+  typedef std::unordered_map<const std::type_info *, Sample> Samples;
+
+  std::string m_filename;
+  // Event being run, if any, and when it was taken off the queue
+  mutable const std::type_info *m_running;
+  bool m_cancelled;
+  uint64_t m_started;
+  bool m_stopped;
+  mutable Samples m_samples;
+  mutable Sample m_cancelledSample;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingScheduler);
+
+} // namespace ns3
+
+#endif /* PROFILING_SCHEDULER_H */
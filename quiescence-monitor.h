@@ -0,0 +1,203 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QUIESCENCE_MONITOR_H
+#define QUIESCENCE_MONITOR_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include <iostream>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Stops the simulation once the applications are done and only
+ * housekeeping is left: beacons, ARP, routing and mobility timers and the
+ * like, which would otherwise keep a run going until its Simulator::Stop.
+ *
+ * The simulator cannot tell these events apart, so the monitor watches
+ * the applications instead.  An application is done once its StopTime has
+ * passed; an echo client (any application with a MaxPackets attribute
+ * and a Tx trace, such as UdpEchoClient) is also done once it has sent
+ * MaxPackets packets.  UdpEchoServers only answer and are never waited for.  When
+ * every other application is done, the run is stopped as soon as no IPv4
+ * packet has been sent, forwarded or delivered for the drain time, which
+ * lets replies still in flight arrive.
+ *
+ * An application that has no StopTime and no packet limit is never done;
+ * the run then ends at its usual Simulator::Stop.
+ */
+class QuiescenceMonitor
+{
+public:
+  /**
+   * \param drain IPv4 silence required before stopping
+   */
+  QuiescenceMonitor (Time drain = Seconds (1))
+    : m_drain (drain),
+      m_remaining (0),
+      m_stopped (false)
+  {
+  }
+
+  /**
+   * Starts watching; call once every application is installed.
+   */
+  void
+  Enable (void)
+  {
+    for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+      {
+        for (uint32_t a = 0; a < (*n)->GetNApplications (); ++a)
+          {
+            Watch ((*n)->GetApplication (a));
+          }
+      }
+    Config::ConnectWithoutContext ("/NodeList/*/$ns3::Ipv4L3Protocol/SendOutgoing",
+                                   MakeCallback (&QuiescenceMonitor::Activity, this));
+    Config::ConnectWithoutContext ("/NodeList/*/$ns3::Ipv4L3Protocol/UnicastForward",
+                                   MakeCallback (&QuiescenceMonitor::Activity, this));
+    Config::ConnectWithoutContext ("/NodeList/*/$ns3::Ipv4L3Protocol/LocalDeliver",
+                                   MakeCallback (&QuiescenceMonitor::Activity, this));
+    if (m_remaining == 0)
+      {
+        ScheduleCheck ();
+      }
+  }
+
+  /**
+   * Whether the monitor ended the run, and when.
+   */
+  bool
+  HasStopped (void) const
+  {
+    return m_stopped;
+  }
+
+  Time
+  GetStopTime (void) const
+  {
+    return m_stopTime;
+  }
+
+private:
+  void
+  Watch (Ptr<Application> app)
+  {
+    TypeId::AttributeInformation info;
+    bool client = app->GetInstanceTypeId ().LookupAttributeByName ("MaxPackets", &info);
+    if (!client && DynamicCast<UdpEchoServer> (app) != 0)
+      {
+        // Servers only answer
+        return;
+      }
+    TimeValue stop;
+    app->GetAttribute ("StopTime", stop);
+
+    Sender sender;
+    sender.done = false;
+    sender.sent = 0;
+    sender.client = client ? app : 0;
+    uint32_t index = m_senders.size ();
+    if (client)
+      {
+        app->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&QuiescenceMonitor::Sent, this, index));
+      }
+    m_senders.push_back (sender);
+    ++m_remaining;
+    if (stop.Get ().IsStrictlyPositive ())
+      {
+        Simulator::Schedule (stop.Get () - Simulator::Now (), &QuiescenceMonitor::Done, this, index);
+      }
+  }
+
+  static void
+  Sent (QuiescenceMonitor *monitor, uint32_t sender, Ptr<const Packet> p)
+  {
+    Sender &s = monitor->m_senders[sender];
+    // Read when the client runs, since MaxPackets may be set until then
+    UintegerValue maxPackets;
+    s.client->GetAttribute ("MaxPackets", maxPackets);
+    if (maxPackets.Get () != 0 && ++s.sent >= maxPackets.Get ())
+      {
+        monitor->Done (sender);
+      }
+  }
+
+  void
+  Done (uint32_t sender)
+  {
+    if (m_senders[sender].done)
+      {
+        return;
+      }
+    m_senders[sender].done = true;
+    if (--m_remaining == 0)
+      {
+        ScheduleCheck ();
+      }
+  }
+
+  void
+  Activity (const Ipv4Header &header, Ptr<const Packet> p, uint32_t interface)
+  {
+    m_lastActivity = Simulator::Now ();
+  }
+
+  void
+  ScheduleCheck (void)
+  {
+    Time wait = m_lastActivity + m_drain - Simulator::Now ();
+    Simulator::Schedule (wait.IsStrictlyPositive () ? wait : Seconds (0), &QuiescenceMonitor::Check, this);
+  }
+
+  void
+  Check (void)
+  {
+    if (Simulator::Now () - m_lastActivity < m_drain)
+      {
+        ScheduleCheck ();
+        return;
+      }
+    m_stopped = true;
+    m_stopTime = Simulator::Now ();
+    std::cout << "Quiescent at " << m_stopTime.GetSeconds () << "s, stopping" << std::endl;
+    Simulator::Stop ();
+  }
+
+  struct Sender
+  {
+    bool done;
+    uint32_t sent;
+    Ptr<Application> client;
+  };
+
+  Time m_drain;
+  // Sending applications not done yet
+  uint32_t m_remaining;
+  std::vector<Sender> m_senders;
+  Time m_lastActivity;
+  bool m_stopped;
+  Time m_stopTime;
+};
+
+} // namespace ns3
+
+#endif /* QUIESCENCE_MONITOR_H */
@@ -0,0 +1,189 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RECORDING_SCHEDULER_H
+#define RECORDING_SCHEDULER_H
+
+#include "ns3/core-module.h"
+#include "ns3/scheduler.h"
+
+#include "wrapping-scheduler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * One operation on the event queue, as written by RecordingScheduler.
+ */
+struct SchedulerTraceRecord
+{
+  enum Operation
+  {
+    INSERT,
+    REMOVE_NEXT,
+    REMOVE
+  };
+
+  uint64_t ts;
+  uint32_t uid;
+  uint32_t context;
+  uint8_t operation;
+  uint8_t reserved[7];
+};
+
+/**
+ * Wrapping scheduler that logs every queue operation, so that the event
+ * queue workload of a script can be replayed by scheduler-benchmark.
+ *
+ * The log is a 16 byte header, "NS3EVTQ" and a version, followed by
+ * SchedulerTraceRecords in host byte order.
+ */
+class RecordingScheduler : public WrappingScheduler
+{
+public:
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = AddInnerAttribute (TypeId ("ns3::RecordingScheduler"))
+      .SetParent<Scheduler> ()
+      .AddConstructor<RecordingScheduler> ()
+      .AddAttribute ("Filename",
+                     "File the queue operations are written to.",
+                     StringValue ("events.evq"),
+                     MakeStringAccessor (&RecordingScheduler::m_filename),
+                     MakeStringChecker ())
+    ;
+    return tid;
+  }
+
+  static const uint32_t VERSION = 1;
+
+  /**
+   * Records the event queue of this run to filename, on top of the
+   * scheduler selected so far.  Call before anything is scheduled.
+   */
+  static void
+  Enable (std::string filename)
+  {
+    if (Wrap (GetTypeId ()))
+      {
+        Config::SetDefault ("ns3::RecordingScheduler::Filename", StringValue (filename));
+      }
+  }
+
+  RecordingScheduler ()
+    : m_file (0)
+  {
+  }
+
+  virtual
+  ~RecordingScheduler ()
+  {
+    if (m_file != 0)
+      {
+        std::fclose (m_file);
+      }
+  }
+
+  virtual void
+  Insert (const Event &ev)
+  {
+    Ptr<Scheduler> inner = GetInner ();
+    Record (SchedulerTraceRecord::INSERT, ev.key);
+    inner->Insert (ev);
+  }
+
+  virtual Event
+  RemoveNext (void)
+  {
+    Event next = WrappingScheduler::RemoveNext ();
+    Record (SchedulerTraceRecord::REMOVE_NEXT, next.key);
+    return next;
+  }
+
+  virtual void
+  Remove (const Event &ev)
+  {
+    Record (SchedulerTraceRecord::REMOVE, ev.key);
+    WrappingScheduler::Remove (ev);
+  }
+
+private:
+  virtual void
+  DoStart (void)
+  {
+    m_file = std::fopen (m_filename.c_str (), "wb");
+    NS_ABORT_MSG_UNLESS (m_file != 0, "Unable to open " << m_filename);
+    std::setvbuf (m_file, 0, _IOFBF, 1 << 20);
+    char header[16] = "NS3EVTQ";
+    uint32_t version = VERSION;
+    std::memcpy (header + 8, &version, sizeof (version));
+    std::fwrite (header, sizeof (header), 1, m_file);
+  }
+
+  void
+  Record (SchedulerTraceRecord::Operation operation, const EventKey &key)
+  {
+    SchedulerTraceRecord r;
+    std::memset (&r, 0, sizeof (r));
+    r.ts = key.m_ts;
+    r.uid = key.m_uid;
+    r.context = key.m_context;
+    r.operation = operation;
+    std::fwrite (&r, sizeof (r), 1, m_file);
+  }
+
+  std::string m_filename;
+  FILE *m_file;
+};
+
+const uint32_t RecordingScheduler::VERSION;
+
+NS_OBJECT_ENSURE_REGISTERED (RecordingScheduler);
+
+/**
+ * Loads a log written by RecordingScheduler.
+ */
+inline std::vector<SchedulerTraceRecord>
+ReadSchedulerTrace (std::string filename)
+{
+  FILE *file = std::fopen (filename.c_str (), "rb");
+  NS_ABORT_MSG_UNLESS (file != 0, "Unable to open " << filename);
+  char header[16];
+  uint32_t version = 0;
+  bool valid = std::fread (header, sizeof (header), 1, file) == 1 && std::strcmp (header, "NS3EVTQ") == 0;
+  if (valid)
+    {
+      std::memcpy (&version, header + 8, sizeof (version));
+    }
+  NS_ABORT_MSG_UNLESS (valid && version == RecordingScheduler::VERSION, filename << " is not an event queue log");
+  std::vector<SchedulerTraceRecord> records;
+  SchedulerTraceRecord r;
+  while (std::fread (&r, sizeof (r), 1, file) == 1)
+    {
+      records.push_back (r);
+    }
+  std::fclose (file);
+  return records;
+}
+
+} // namespace ns3
+
+#endif /* RECORDING_SCHEDULER_H */
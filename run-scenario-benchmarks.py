@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+"""Runs the scratch scenarios with --benchOutput and compares results.
+
+Each run appends one JSON line (see scenario-bench.h) to the output file;
+keep one file per build and compare two of them:
+
+  scratch/run-scenario-benchmarks.py run --nodes=3,30 --packets=0,100 \\
+      --tracing=0,1 --repeat=3 --output=before.jsonl
+  ... rebuild ...
+  scratch/run-scenario-benchmarks.py run ... --output=after.jsonl
+  scratch/run-scenario-benchmarks.py compare before.jsonl after.jsonl
+
+The same goes for one build with and without the slab allocator: run the
+suite once more with --slabs into a second file and compare the two.
+--profile likewise measures what ProfilingScheduler costs, by running
+the scenarios with --profileEvents (the profiles go next to the output).
+
+Every scenario is run with each combination of the knobs it has; the
+Wi-Fi and point-to-point scenarios with a fixed topology take no node
+count.  Echo logging is turned off so that it does not dominate the run.
+"""
+
+import argparse
+import itertools
+import json
+import os
+import statistics
+import subprocess
+import sys
+
+# Command line options of each scenario for the knobs of the suite
+SCENARIOS = {
+    "scratch-simulator": {},
+    "myfirst": {"packets": "nPackets", "tracing": "tracing", "profile": "profileEvents", "quiet": True},
+    "ex2": {"packets": "nPackets", "tracing": "tracing", "profile": "profileEvents", "quiet": True},
+    "mysecond": {"nodes": ["nCsma"], "packets": "nPackets", "tracing": "tracing", "profile": "profileEvents",
+                 "quiet": True},
+    "lab3p2": {"nodes": ["nCsma"], "packets": "nPackets", "tracing": "tracing", "profile": "profileEvents",
+               "quiet": True},
+    "MyThirdExample": {"nodes": ["nCsma", "nWifi"], "packets": "nPackets", "tracing": "tracing",
+                       "profile": "profileEvents", "quiet": True},
+    "lab4ex1": {"nodes": ["nCsma", "nWifi"], "packets": "nPackets", "tracing": "tracing",
+                "profile": "profileEvents", "quiet": True},
+    "Game": {"packets": "nPackets", "tracing": "tracing", "profile": "profileEvents", "quiet": True},
+    "FinalProject": {"packets": "nPackets", "tracing": "tracing", "profile": "profileEvents", "quiet": True},
+    "lab5": {"packets": "nPackets", "tracing": "tracing", "profile": "profileEvents", "quiet": True},
+}
+
+# Stations beyond this do not fit in the mobility bounding box
+MAX_WIFI = 18
+
+METRICS = ["runSeconds", "eventsPerSecond", "simSecondsPerWallSecond", "peakRssKib", "runAllocations",
+           "runAllocatedBytesPerEcho", "slabPeakObjects"]
+
+
+def parse_list(text, convert):
+    return [convert(v) for v in text.split(",") if v != ""]
+
+
+def configurations(name, nodes, packets, tracing):
+    knobs = SCENARIOS[name]
+    axes = []
+    if "nodes" in knobs:
+        axes.append([[("--%s=%d" % (o, min(n, MAX_WIFI) if o == "nWifi" else n)) for o in knobs["nodes"]]
+                     for n in nodes])
+    if "packets" in knobs:
+        axes.append([["--%s=%d" % (knobs["packets"], n)] for n in packets])
+    if "tracing" in knobs:
+        axes.append([["--%s=%d" % (knobs["tracing"], t)] for t in tracing])
+    for combination in itertools.product(*axes):
+        args = ["--verbose=0"] if knobs.get("quiet") else []
+        for part in combination:
+            args.extend(part)
+        yield args
+
+
+def run(options):
+    waf = os.path.abspath(options.waf)
+    top = os.path.dirname(waf)
+    output = os.path.abspath(options.output)
+    if subprocess.call([waf, "build"], cwd=top, stdout=subprocess.DEVNULL) != 0:
+        sys.exit("build failed")
+    names = parse_list(options.scenarios, str)
+    for name in names:
+        if name not in SCENARIOS:
+            sys.exit("unknown scenario %s" % name)
+    failures = 0
+    for name in names:
+        for args in configurations(name, parse_list(options.nodes, int), parse_list(options.packets, int),
+                                   parse_list(options.tracing, int)):
+            if options.slabs:
+                args = args + ["--SlabAllocator=1"]
+            if options.profile and "profile" in SCENARIOS[name]:
+                args = args + ["--%s=%s.%s.folded" % (SCENARIOS[name]["profile"], output, name)]
+            command = " ".join([name] + args + ["--benchOutput=" + output])
+            for _ in range(options.repeat):
+                print(command, flush=True)
+                result = subprocess.run([waf, "--run", command], cwd=top, stdout=subprocess.DEVNULL,
+                                        stderr=subprocess.PIPE, universal_newlines=True)
+                if result.returncode != 0:
+                    failures += 1
+                    sys.stderr.write(result.stderr)
+    if failures:
+        sys.exit("%d runs failed" % failures)
+
+
+def load(filename):
+    runs = {}
+    with open(filename) as f:
+        for line in f:
+            if line.strip():
+                r = json.loads(line)
+                runs.setdefault((r["scenario"], r["args"]), []).append(r)
+    return runs
+
+
+def median(runs, metric):
+    return statistics.median(r.get(metric, 0) for r in runs)
+
+
+def compare(options):
+    before = load(options.before)
+    after = load(options.after)
+    print("%-16s %-44s %-24s %14s %14s %8s" % ("scenario", "args", "metric", "before", "after", "ratio"))
+    for key in sorted(set(before) & set(after)):
+        if median(before[key], "events") != median(after[key], "events"):
+            print("%-16s %-44s events differ: the builds do not run the same workload" % key)
+        for metric in METRICS:
+            b = median(before[key], metric)
+            a = median(after[key], metric)
+            ratio = a / b if b else float("nan")
+            print("%-16s %-44s %-24s %14.6g %14.6g %8.3f" % (key[0], key[1], metric, b, a, ratio))
+    for key in sorted(set(before) ^ set(after)):
+        print("%-16s %-44s only in %s" % (key[0], key[1], options.before if key in before else options.after))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command")
+    r = commands.add_parser("run", help="run the suite, appending to --output")
+    r.add_argument("--waf", default="./waf", help="waf of the ns-3 tree holding the scenarios")
+    r.add_argument("--output", default="scenario-bench.jsonl")
+    r.add_argument("--scenarios", default=",".join(SCENARIOS), help="comma separated")
+    r.add_argument("--nodes", default="3", help="comma separated node counts")
+    r.add_argument("--packets", default="0", help="comma separated echo packet counts, 0 = as in the scenario")
+    r.add_argument("--tracing", default="0", help="comma separated, 0 and/or 1")
+    r.add_argument("--repeat", type=int, default=3, help="runs of each configuration")
+    r.add_argument("--slabs", action="store_true", help="serve small allocations from the slab allocator")
+    r.add_argument("--profile", action="store_true", help="profile the events of each run with --profileEvents")
+    c = commands.add_parser("compare", help="compare the median results of two output files")
+    c.add_argument("before")
+    c.add_argument("after")
+    options = parser.parse_args()
+    if options.command == "run":
+        run(options)
+    elif options.command == "compare":
+        compare(options)
+    else:
+        parser.print_help()
+
+
+if __name__ == "__main__":
+    main()
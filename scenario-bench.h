@@ -0,0 +1,352 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCENARIO_BENCH_H
+#define SCENARIO_BENCH_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/scheduler.h"
+
+#include "alloc-stats.h"
+#include "wrapping-scheduler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+namespace ns3 {
+
+/**
+ * Wrapping scheduler that counts the events taken off the queue, i.e. the
+ * events executed.
+ */
+class CountingScheduler : public WrappingScheduler
+{
+public:
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = AddInnerAttribute (TypeId ("ns3::CountingScheduler"))
+      .SetParent<Scheduler> ()
+      .AddConstructor<CountingScheduler> ()
+    ;
+    return tid;
+  }
+
+  /**
+   * Counts the events of this run, on top of the scheduler selected so
+   * far.  Call before anything is scheduled.
+   */
+  static void
+  Enable (void)
+  {
+    Wrap (GetTypeId ());
+  }
+
+  /**
+   * Events executed so far, by every CountingScheduler of the process.
+   */
+  static uint64_t &
+  GetEvents (void)
+  {
+    static uint64_t events = 0;
+    return events;
+  }
+
+  virtual Event
+  RemoveNext (void)
+  {
+    ++GetEvents ();
+    return WrappingScheduler::RemoveNext ();
+  }
+};
+
+NS_OBJECT_ENSURE_REGISTERED (CountingScheduler);
+
+// Read by ScenarioBench, which every program here constructs once the
+// command line, where --SlabAllocator=1 sets it, has been parsed.
+static GlobalValue g_slabAllocator ("SlabAllocator",
+                                    "Serve allocations of up to 4 KiB (packets, buffers, tags, metadata) "
+                                    "from per-thread size class slabs instead of malloc",
+                                    BooleanValue (false),
+                                    MakeBooleanChecker ());
+
+/**
+ * Measures one run of a scenario and appends the result, as one line of
+ * JSON, to a file; run-scenario-benchmarks.py drives the suite and
+ * compares result files of two builds.
+ *
+ * The line holds the scenario name and its command line (less
+ * --benchOutput), which together identify the configuration, then:
+ * setupSeconds, wall time from construction to the first event;
+ * runSeconds, from the first event to Simulator::Destroy; events and
+ * eventsPerSecond; simSeconds and simSecondsPerWallSecond; peakRssKib,
+ * the peak resident set of the process; and the heap allocations made
+ * during setup and during the run, with the bytes requested by the latter;
+ * echoes, the replies that reached an echo client during the run, and
+ * runAllocatedBytesPerEcho, the run's allocated bytes divided by them,
+ * which tracks the bytes copied per echo: a Buffer copy goes into new
+ * data, taken from the heap unless Buffer's own free list has a block;
+ * and slabPeakObjects, the most slab blocks in use at once with the
+ * SlabAllocator global value set, 0 otherwise.  --SlabAllocator and
+ * --profileEvents are left out of the command line, so that runs with and
+ * without them compare.
+ *
+ * Construct it once the command line is parsed and any other
+ * SchedulerType change is made, before the scenario is built, and call
+ * SetPackets right after: either may schedule the event marking the start
+ * of the run, which has to be the first one at time zero.  With no output
+ * file nothing is counted or measured and, unless SetPackets is given a
+ * count, nothing is scheduled, but SetPackets still applies.
+ */
+class ScenarioBench
+{
+public:
+  ScenarioBench (std::string scenario, std::string output, int argc, char *argv[])
+    : m_scenario (scenario),
+      m_output (output),
+      m_packets (0),
+      m_setupStart (GetWallSeconds ()),
+      m_setupAllocations (AllocStats::Get ().allocations),
+      m_runStart (m_setupStart),
+      m_runCounts (AllocStats::Get ()),
+      m_runEvents (CountingScheduler::GetEvents ()),
+      m_echoes (0),
+      m_markerScheduled (false)
+  {
+    for (int i = 1; i < argc; ++i)
+      {
+        std::string arg = argv[i];
+        if (arg.compare (0, 13, "--benchOutput") != 0 && arg.compare (0, 15, "--SlabAllocator") != 0
+            && arg.compare (0, 15, "--profileEvents") != 0)
+          {
+            m_arguments += (m_arguments.empty () ? "" : " ") + arg;
+          }
+      }
+    if (!m_output.empty ())
+      {
+        AllocStats::EnableCounting ();
+        m_setupAllocations = AllocStats::Get ().allocations;
+        CountingScheduler::Enable ();
+        Simulator::ScheduleDestroy (&ScenarioBench::Report, this);
+        ScheduleMarker ();
+      }
+    BooleanValue slabs;
+    g_slabAllocator.GetValue (slabs);
+    if (slabs.Get ())
+      {
+        NS_ABORT_MSG_UNLESS (AllocStats::EnableSlabs (), "Unable to reserve the slab arena");
+      }
+  }
+
+  /**
+   * Makes every echo client, i.e. application with a MaxPackets
+   * attribute, send packets packets, sooner if they would not otherwise
+   * all fit between its start and stop times; 0 leaves the clients as the
+   * scenario set them up.
+   */
+  void
+  SetPackets (uint32_t packets)
+  {
+    m_packets = packets;
+    if (m_packets != 0)
+      {
+        ScheduleMarker ();
+      }
+  }
+
+private:
+  static double
+  GetWallSeconds (void)
+  {
+    struct timeval now;
+    gettimeofday (&now, 0);
+    return now.tv_sec + now.tv_usec * 1e-6;
+  }
+
+  void
+  ScheduleMarker (void)
+  {
+    if (!m_markerScheduled)
+      {
+        Simulator::Schedule (Seconds (0), &ScenarioBench::RunStarted, this);
+        m_markerScheduled = true;
+      }
+  }
+
+  void
+  RunStarted (void)
+  {
+    if (m_packets != 0)
+      {
+        ApplyPackets ();
+      }
+    if (!m_output.empty ())
+      {
+        WatchEchoes ();
+      }
+    m_runStart = GetWallSeconds ();
+    m_runCounts = AllocStats::Get ();
+    m_runEvents = CountingScheduler::GetEvents ();
+  }
+
+  void
+  ApplyPackets (void)
+  {
+    for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+      {
+        for (uint32_t a = 0; a < (*n)->GetNApplications (); ++a)
+          {
+            Ptr<Application> client = (*n)->GetApplication (a);
+            TypeId::AttributeInformation info;
+            if (!client->GetInstanceTypeId ().LookupAttributeByName ("MaxPackets", &info))
+              {
+                continue;
+              }
+            TimeValue start, stop, interval;
+            client->GetAttribute ("StartTime", start);
+            client->GetAttribute ("StopTime", stop);
+            client->GetAttribute ("Interval", interval);
+            client->SetAttribute ("MaxPackets", UintegerValue (m_packets));
+            if (stop.Get () > start.Get ())
+              {
+                Time fit = TimeStep ((stop.Get () - start.Get ()).GetTimeStep () / m_packets);
+                client->SetAttribute ("Interval", TimeValue (std::min (fit, interval.Get ())));
+              }
+          }
+      }
+  }
+
+  /**
+   * Counts the UDP packets delivered to the node of each echo client from
+   * the port it sends to, i.e. the echo replies.
+   */
+  void
+  WatchEchoes (void)
+  {
+    std::set<std::pair<uint32_t, uint16_t> > watched;
+    for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+      {
+        for (uint32_t a = 0; a < (*n)->GetNApplications (); ++a)
+          {
+            Ptr<Application> client = (*n)->GetApplication (a);
+            TypeId::AttributeInformation info;
+            if (!client->GetInstanceTypeId ().LookupAttributeByName ("MaxPackets", &info)
+                || !client->GetInstanceTypeId ().LookupAttributeByName ("RemotePort", &info))
+              {
+                continue;
+              }
+            UintegerValue port;
+            client->GetAttribute ("RemotePort", port);
+            if (!watched.insert (std::make_pair ((*n)->GetId (), port.Get ())).second)
+              {
+                continue;
+              }
+            std::ostringstream path;
+            path << "/NodeList/" << (*n)->GetId () << "/$ns3::Ipv4L3Protocol/LocalDeliver";
+            Config::ConnectWithoutContext (path.str (), MakeBoundCallback (&ScenarioBench::EchoDelivered, this,
+                                                                           static_cast<uint16_t> (port.Get ())));
+          }
+      }
+  }
+
+  static void
+  EchoDelivered (ScenarioBench *bench, uint16_t port, const Ipv4Header &header, Ptr<const Packet> p,
+                 uint32_t interface)
+  {
+    if (header.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+      {
+        return;
+      }
+    UdpHeader udp;
+    p->PeekHeader (udp);
+    if (udp.GetSourcePort () == port)
+      {
+        ++bench->m_echoes;
+      }
+  }
+
+  static std::string
+  Quote (std::string s)
+  {
+    std::string quoted = "\"";
+    for (std::string::const_iterator c = s.begin (); c != s.end (); ++c)
+      {
+        if (*c == '"' || *c == '\\')
+          {
+            quoted += '\\';
+          }
+        quoted += *c;
+      }
+    return quoted + "\"";
+  }
+
+  void
+  Report (void)
+  {
+    double end = GetWallSeconds ();
+    AllocStats::Counts counts = AllocStats::Get ();
+    uint64_t events = CountingScheduler::GetEvents () - m_runEvents;
+    double runSeconds = std::max (end - m_runStart, 1e-9);
+    double simSeconds = Simulator::Now ().GetSeconds ();
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+
+    std::ofstream out (m_output.c_str (), std::ios::app);
+    NS_ABORT_MSG_UNLESS (out, "Unable to open " << m_output);
+    out << std::setprecision (9)
+        << "{\"scenario\":" << Quote (m_scenario)
+        << ",\"args\":" << Quote (m_arguments)
+        << ",\"setupSeconds\":" << m_runStart - m_setupStart
+        << ",\"runSeconds\":" << runSeconds
+        << ",\"events\":" << events
+        << ",\"eventsPerSecond\":" << events / runSeconds
+        << ",\"simSeconds\":" << simSeconds
+        << ",\"simSecondsPerWallSecond\":" << simSeconds / runSeconds
+        << ",\"peakRssKib\":" << usage.ru_maxrss
+        << ",\"setupAllocations\":" << m_runCounts.allocations - m_setupAllocations
+        << ",\"runAllocations\":" << counts.allocations - m_runCounts.allocations
+        << ",\"runAllocatedBytes\":" << counts.bytes - m_runCounts.bytes
+        << ",\"echoes\":" << m_echoes
+        << ",\"runAllocatedBytesPerEcho\":" << (m_echoes == 0 ? 0.0 : double (counts.bytes - m_runCounts.bytes) / m_echoes)
+        << ",\"slabPeakObjects\":" << AllocStats::GetSlabs ().peak
+        << "}" << std::endl;
+  }
+
+  std::string m_scenario;
+  std::string m_output;
+  std::string m_arguments;
+  uint32_t m_packets;
+  double m_setupStart;
+  uint64_t m_setupAllocations;
+  double m_runStart;
+  AllocStats::Counts m_runCounts;
+  uint64_t m_runEvents;
+  uint64_t m_echoes;
+  bool m_markerScheduled;
+};
+
+} // namespace ns3
+
+#endif /* SCENARIO_BENCH_H */
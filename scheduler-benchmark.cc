@@ -0,0 +1,238 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Replays event queue logs against each scheduler and reports how fast
+// each one gets through them.  Record the logs first, e.g.
+//
+//   ./waf --run "mysecond --nCsma=200 --recordEvents=mysecond.evq"
+//   ./waf --run "lab4ex1 --recordEvents=lab4ex1.evq"
+//   ./waf --run "ex2 --recordEvents=ex2.evq"
+//   ./waf --run "scheduler-benchmark --traces=mysecond.evq,lab4ex1.evq,ex2.evq --scale=100"
+//
+// --scale=N replays N copies of a log at once, each shifted by one time
+// step, so the queue holds N times as many events with the same mix of
+// operations.  Memory is the peak of the bytes held on the heap while a
+// log is replayed, above what was held before, as AllocStats counts them.
+// The resident set size can't be used for this: a forked child inherits
+// the parent's high water mark, and reuses the pages the parent freed.
+// Every scheduler still runs in a forked child, so that none of them
+// starts on a heap another one has fragmented.
+
+#include "ns3/core-module.h"
+
+#include "alloc-stats.h"
+#include "fork-sweep.h"
+#include "ladder-scheduler.h"
+#include "recording-scheduler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <sys/time.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SchedulerBenchmark");
+
+class SchedulerBenchmark
+{
+public:
+  SchedulerBenchmark (std::string filename, uint32_t scale, std::vector<std::string> schedulers)
+    : m_filename (filename),
+      m_records (ReadSchedulerTrace (filename)),
+      m_scale (scale),
+      m_schedulers (schedulers)
+  {
+    FindStaleRemoves ();
+  }
+
+  /**
+   * Replays the log against scheduler i; run in a child.
+   *
+   * \returns the peak heap growth in KiB
+   */
+  uint32_t
+  Run (uint32_t i)
+  {
+    int64_t baseline = AllocStats::GetHeap ().live;
+    AllocStats::ResetHeapPeak ();
+    Ptr<Scheduler> scheduler = Create (m_schedulers[i]);
+
+    struct timeval start;
+    gettimeofday (&start, 0);
+    uint64_t events = 0;
+    uint64_t removes = 0;
+    for (std::vector<SchedulerTraceRecord>::const_iterator r = m_records.begin (); r != m_records.end (); ++r)
+      {
+        for (uint32_t copy = 0; copy < m_scale; ++copy)
+          {
+            switch (r->operation)
+              {
+              case SchedulerTraceRecord::INSERT:
+                scheduler->Insert (MakeEvent (*r, copy));
+                break;
+              case SchedulerTraceRecord::REMOVE_NEXT:
+                scheduler->RemoveNext ();
+                ++events;
+                break;
+              case SchedulerTraceRecord::REMOVE:
+                if (!m_staleRemoves[removes++])
+                  {
+                    scheduler->Remove (MakeEvent (*r, copy));
+                  }
+                break;
+              }
+          }
+      }
+    struct timeval end;
+    gettimeofday (&end, 0);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * 1e-6;
+    uint64_t peak = (AllocStats::GetHeap ().peak - baseline) / 1024;
+
+    std::cout << std::left << std::setw (24) << m_schedulers[i] << std::right
+              << std::setw (12) << events << " events "
+              << std::setw (12) << uint64_t (events / std::max (seconds, 1e-9)) << " events/s "
+              << std::setw (10) << peak << " KiB peak" << std::endl;
+    return peak;
+  }
+
+  void
+  PrintHeader (void) const
+  {
+    std::cout << m_filename << ": " << m_records.size () << " queue operations x " << m_scale << std::endl;
+  }
+
+  static Ptr<Scheduler>
+  Create (std::string name)
+  {
+    ObjectFactory factory;
+    if (name == "ladder-lazy")
+      {
+        factory.SetTypeId (LadderScheduler::GetTypeId ());
+        factory.Set ("LazyRemove", BooleanValue (true));
+      }
+    else
+      {
+        factory.SetTypeId ("ns3::" + std::string (1, std::toupper (name[0])) + name.substr (1) + "Scheduler");
+      }
+    return factory.Create<Scheduler> ();
+  }
+
+private:
+  Scheduler::Event
+  MakeEvent (const SchedulerTraceRecord &r, uint32_t copy) const
+  {
+    Scheduler::Event ev;
+    ev.impl = 0;
+    ev.key.m_ts = r.ts + copy;
+    ev.key.m_uid = r.uid * m_scale + copy;
+    ev.key.m_context = r.context;
+    return ev;
+  }
+
+  /**
+   * The copies of a log pop each other's events, so a Simulator::Remove
+   * in the log may target an event already gone; find those once, with a
+   * reference queue, so that no scheduler is asked to remove them.
+   */
+  void
+  FindStaleRemoves (void)
+  {
+    std::set<std::pair<uint64_t, uint32_t> > queue;
+    for (std::vector<SchedulerTraceRecord>::const_iterator r = m_records.begin (); r != m_records.end (); ++r)
+      {
+        for (uint32_t copy = 0; copy < m_scale; ++copy)
+          {
+            Scheduler::Event ev = MakeEvent (*r, copy);
+            std::pair<uint64_t, uint32_t> key (ev.key.m_ts, ev.key.m_uid);
+            switch (r->operation)
+              {
+              case SchedulerTraceRecord::INSERT:
+                NS_ABORT_MSG_IF ((uint64_t (r->uid) + 1) * m_scale > 0xffffffff,
+                                 "--scale is too large for the event ids of " << m_filename);
+                queue.insert (key);
+                break;
+              case SchedulerTraceRecord::REMOVE_NEXT:
+                NS_ABORT_MSG_IF (queue.empty (), m_filename << " removes from an empty queue");
+                queue.erase (queue.begin ());
+                break;
+              case SchedulerTraceRecord::REMOVE:
+                m_staleRemoves.push_back (queue.erase (key) == 0);
+                break;
+              }
+          }
+      }
+  }
+
+  std::string m_filename;
+  std::vector<SchedulerTraceRecord> m_records;
+  uint32_t m_scale;
+  std::vector<std::string> m_schedulers;
+  std::vector<bool> m_staleRemoves;
+};
+
+int
+main (int argc, char *argv[])
+{
+  std::string traces = "events.evq";
+  std::string schedulers = "map,heap,calendar,ladder,ladder-lazy";
+  uint32_t scale = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("traces", "Comma separated event queue logs written with --recordEvents", traces);
+  cmd.AddValue ("schedulers", "Comma separated schedulers: list, map, heap, calendar, ladder, ladder-lazy", schedulers);
+  cmd.AddValue ("scale", "Copies of each log replayed at the same time", scale);
+  cmd.Parse (argc, argv);
+  AllocStats::EnableHeapBytes ();
+
+  std::vector<std::string> names;
+  std::istringstream iss (schedulers);
+  std::string name;
+  while (std::getline (iss, name, ','))
+    {
+      if (!name.empty ())
+        {
+          SchedulerBenchmark::Create (name);
+          names.push_back (name);
+        }
+    }
+
+  std::istringstream tracesStream (traces);
+  std::string trace;
+  while (std::getline (tracesStream, trace, ','))
+    {
+      if (trace.empty ())
+        {
+          continue;
+        }
+      SchedulerBenchmark benchmark (trace, std::max (1u, scale), names);
+      benchmark.PrintHeader ();
+      ForkSweep sweep (1);
+      std::vector<uint32_t> peaks = sweep.Run (names.size (), MakeCallback (&SchedulerBenchmark::Run, &benchmark));
+      for (uint32_t i = 0; i < peaks.size (); ++i)
+        {
+          if (peaks[i] == ForkSweep::FAILED)
+            {
+              std::cout << names[i] << " failed" << std::endl;
+            }
+        }
+    }
+  return 0;
+}
@@ -16,12 +16,25 @@
 
 #include "ns3/core-module.h"
 
+#include "scenario-bench.h"
+
 NS_LOG_COMPONENT_DEFINE ("ScratchSimulator");
 
 using namespace ns3;
 
+// With --benchOutput, an empty run: the cost of starting ns-3 that every
+// other scenario pays as well.
 int 
 main (int argc, char *argv[])
 {
+  std::string benchOutput = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("benchOutput", "Append wall time, events, memory and allocations of the run to this file", benchOutput);
+  cmd.Parse (argc, argv);
+
+  ScenarioBench bench ("scratch-simulator", benchOutput, argc, argv);
   NS_LOG_UNCOND ("Hello World");
+  Simulator::Run ();
+  Simulator::Destroy ();
 }
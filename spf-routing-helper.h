@@ -0,0 +1,650 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SPF_ROUTING_HELPER_H
+#define SPF_ROUTING_HELPER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include "ipv4-trie-routing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Replacement for Ipv4GlobalRoutingHelper::PopulateRoutingTables that
+ * installs shortest path routes into each node's Ipv4StaticRouting.
+ *
+ * The topology is flattened once into a compressed adjacency array: every
+ * node and every channel is a vertex, and each IPv4 interface (an
+ * "attachment") is an edge pair between its node and its channel, costing
+ * the interface metric towards the channel and nothing back.  Point to
+ * point links, CSMA buses and Wi-Fi channels are all handled the same way.
+ * The shortest path trees of the sources are then computed on worker
+ * threads, which only read the array, and the resulting routes are
+ * installed from the calling thread.  Nodes given an Ipv4TrieRouting get
+ * their routes there instead of in Ipv4StaticRouting.
+ *
+ * After an interface is brought up or down, NotifyInterfaceChanged
+ * recomputes only what the change can affect: for a failure, the sources
+ * whose tree used that interface; for a repair, every source.
+ */
+class SpfRoutingHelper
+{
+public:
+  /**
+   * \param nThreads threads computing trees, 0 for one per core
+   */
+  SpfRoutingHelper (uint32_t nThreads = 0)
+    : m_nThreads (nThreads == 0 ? std::max (1u, std::thread::hardware_concurrency ()) : nThreads),
+      m_nNodes (0),
+      m_nChannels (0),
+      m_generation (0),
+      m_populated (false),
+      m_lastRecomputed (0)
+  {
+  }
+
+  /**
+   * Computes and installs routes for every node; call once the topology
+   * and addresses are in place, where PopulateRoutingTables would be
+   * called.
+   */
+  void
+  Populate (void)
+  {
+    Build ();
+    m_populated = true;
+    std::vector<uint32_t> sources;
+    for (uint32_t n = 0; n < m_nNodes; ++n)
+      {
+        if (m_router[n])
+          {
+            sources.push_back (n);
+          }
+      }
+    Compute (sources);
+  }
+
+  /**
+   * Only flattens the topology, for FindFirstHop; no route is installed.
+   */
+  void
+  Build (void)
+  {
+    BuildGraph ();
+    BuildAdjacency ();
+    ++m_generation;
+  }
+
+  /**
+   * Computes the first hop from node source towards destination, searching
+   * only as far as the destination's subnet.
+   *
+   * \returns false if destination is not on any known subnet or cannot be
+   *          reached; otherwise interface and gateway are set (gateway
+   *          0.0.0.0 for a directly connected subnet) along with the path
+   *          cost in metric
+   */
+  bool
+  FindFirstHop (uint32_t source, Ipv4Address destination,
+                uint32_t &interface, Ipv4Address &gateway, uint32_t &metric)
+  {
+    uint32_t target = 0;
+    bool found = false;
+    for (std::set<uint32_t>::const_reverse_iterator l = m_prefixLengths.rbegin ();
+         !found && l != m_prefixLengths.rend (); ++l)
+      {
+        uint32_t mask = *l == 0 ? 0 : 0xffffffff << (32 - *l);
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t>::const_iterator c =
+          m_subnetIndex.find (std::make_pair (*l, destination.Get () & mask));
+        if (c != m_subnetIndex.end ())
+          {
+            target = m_nNodes + c->second;
+            found = true;
+          }
+      }
+    if (!found || !m_router[source])
+      {
+        return false;
+      }
+    Search (source, target, m_workspace);
+    if (m_workspace.dist[target] == INFINITE)
+      {
+        return false;
+      }
+    interface = m_workspace.hopInterface[target];
+    gateway = Ipv4Address (m_workspace.hopGateway[target]);
+    metric = m_workspace.dist[target];
+    return true;
+  }
+
+  /**
+   * Incremented whenever the topology seen by FindFirstHop changes, so
+   * that answers cached from it can be dropped.
+   */
+  uint32_t
+  GetGeneration (void) const
+  {
+    return m_generation;
+  }
+
+  /**
+   * Updates the routes after interface of node was set up or down.  If
+   * only Build was called, just the graph is updated.
+   */
+  void
+  NotifyInterfaceChanged (Ptr<Node> node, uint32_t interface)
+  {
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t>::const_iterator it =
+      m_attachmentIndex.find (std::make_pair (node->GetId (), interface));
+    if (it == m_attachmentIndex.end ())
+      {
+        return;
+      }
+    Attachment &a = m_attachments[it->second];
+    bool up = node->GetObject<Ipv4> ()->IsUp (interface);
+    if (up == a.up)
+      {
+        return;
+      }
+    a.up = up;
+    BuildAdjacency ();
+    ++m_generation;
+    if (!m_populated)
+      {
+        return;
+      }
+
+    std::vector<uint32_t> sources;
+    for (uint32_t n = 0; n < m_nNodes; ++n)
+      {
+        if (m_router[n] && (up || IsUsed (n, it->second)))
+          {
+            sources.push_back (n);
+          }
+      }
+    Compute (sources);
+  }
+
+  /// Number of sources whose routes were computed by the last call
+  uint32_t
+  GetLastRecomputed (void) const
+  {
+    return m_lastRecomputed;
+  }
+
+private:
+  struct Attachment
+  {
+    uint32_t node;
+    uint32_t interface;
+    uint32_t channel;
+    uint32_t address;
+    uint16_t metric;
+    bool up;
+    bool forwarding;
+  };
+
+  struct Subnet
+  {
+    uint32_t network;
+    uint32_t mask;
+  };
+
+  struct Route
+  {
+    uint32_t network;
+    uint32_t mask;
+    uint32_t gateway;
+    uint32_t interface;
+    uint32_t metric;
+
+    bool
+    operator< (const Route &o) const
+    {
+      if (network != o.network)
+        {
+          return network < o.network;
+        }
+      if (mask != o.mask)
+        {
+          return mask < o.mask;
+        }
+      if (gateway != o.gateway)
+        {
+          return gateway < o.gateway;
+        }
+      return interface < o.interface;
+    }
+  };
+
+  struct Result
+  {
+    std::vector<Route> routes;
+    std::vector<uint64_t> used;
+  };
+
+  // Per thread scratch space, reused from one source to the next
+  struct Workspace
+  {
+    std::vector<uint32_t> dist;
+    std::vector<uint32_t> via;
+    std::vector<uint32_t> hopInterface;
+    std::vector<uint32_t> hopGateway;
+    std::vector<std::pair<uint32_t, uint32_t> > heap;
+    std::vector<uint32_t> touched;
+  };
+
+  // A slice of sources handed to the worker threads
+  struct Batch
+  {
+    const std::vector<uint32_t> *sources;
+    uint32_t begin;
+    uint32_t end;
+    std::atomic<uint32_t> next;
+    std::vector<Result> results;
+  };
+
+  static const uint32_t INFINITE = 0xffffffff;
+
+  void
+  BuildGraph (void)
+  {
+    m_nNodes = NodeList::GetNNodes ();
+    m_router.assign (m_nNodes, false);
+    m_attachments.clear ();
+    m_attachmentIndex.clear ();
+    std::map<const Channel *, uint32_t> channels;
+    std::vector<std::vector<Subnet> > subnets;
+
+    for (uint32_t n = 0; n < m_nNodes; ++n)
+      {
+        Ptr<Ipv4> ipv4 = NodeList::GetNode (n)->GetObject<Ipv4> ();
+        if (ipv4 == 0)
+          {
+            continue;
+          }
+        m_router[n] = true;
+        for (uint32_t i = 0; i < ipv4->GetNInterfaces (); ++i)
+          {
+            Ptr<Channel> channel = ipv4->GetNetDevice (i)->GetChannel ();
+            if (channel == 0 || ipv4->GetNAddresses (i) == 0)
+              {
+                // The loopback interface and unconnected devices
+                continue;
+              }
+            std::map<const Channel *, uint32_t>::iterator c = channels.find (PeekPointer (channel));
+            if (c == channels.end ())
+              {
+                c = channels.insert (std::make_pair (PeekPointer (channel), channels.size ())).first;
+                subnets.push_back (std::vector<Subnet> ());
+              }
+
+            Attachment a;
+            a.node = n;
+            a.interface = i;
+            a.channel = c->second;
+            a.address = ipv4->GetAddress (i, 0).GetLocal ().Get ();
+            a.metric = ipv4->GetMetric (i);
+            a.up = ipv4->IsUp (i);
+            a.forwarding = ipv4->IsForwarding (i);
+            m_attachmentIndex[std::make_pair (n, i)] = m_attachments.size ();
+            m_attachments.push_back (a);
+
+            for (uint32_t j = 0; j < ipv4->GetNAddresses (i); ++j)
+              {
+                Ipv4InterfaceAddress address = ipv4->GetAddress (i, j);
+                Subnet s;
+                s.mask = address.GetMask ().Get ();
+                s.network = address.GetLocal ().Get () & s.mask;
+                std::vector<Subnet> &list = subnets[c->second];
+                bool known = false;
+                for (uint32_t k = 0; k < list.size (); ++k)
+                  {
+                    known = known || (list[k].network == s.network && list[k].mask == s.mask);
+                  }
+                if (!known)
+                  {
+                    list.push_back (s);
+                  }
+              }
+          }
+      }
+
+    m_nChannels = channels.size ();
+    m_subnetStart.assign (1, 0);
+    m_subnets.clear ();
+    m_subnetIndex.clear ();
+    m_prefixLengths.clear ();
+    for (uint32_t c = 0; c < m_nChannels; ++c)
+      {
+        m_subnets.insert (m_subnets.end (), subnets[c].begin (), subnets[c].end ());
+        m_subnetStart.push_back (m_subnets.size ());
+        for (uint32_t k = 0; k < subnets[c].size (); ++k)
+          {
+            uint32_t length = Ipv4Mask (subnets[c][k].mask).GetPrefixLength ();
+            m_subnetIndex[std::make_pair (length, subnets[c][k].network)] = c;
+            m_prefixLengths.insert (length);
+          }
+      }
+    m_installed.assign (m_nNodes, std::vector<Route> ());
+    m_used.assign (m_nNodes, std::vector<uint64_t> ());
+  }
+
+  // Vertices 0 .. m_nNodes - 1 are nodes, the rest channels.  Each edge is
+  // stored as the attachment it comes from; its far end is the attachment's
+  // channel seen from a node and its node seen from a channel.
+  void
+  BuildAdjacency (void)
+  {
+    uint32_t nVertices = m_nNodes + m_nChannels;
+    m_start.assign (nVertices + 1, 0);
+    for (uint32_t i = 0; i < m_attachments.size (); ++i)
+      {
+        const Attachment &a = m_attachments[i];
+        if (a.up)
+          {
+            ++m_start[a.node + 1];
+            ++m_start[m_nNodes + a.channel + 1];
+          }
+      }
+    for (uint32_t v = 0; v < nVertices; ++v)
+      {
+        m_start[v + 1] += m_start[v];
+      }
+    m_edges.resize (m_start[nVertices]);
+    std::vector<uint32_t> fill (m_start.begin (), m_start.end () - 1);
+    for (uint32_t i = 0; i < m_attachments.size (); ++i)
+      {
+        const Attachment &a = m_attachments[i];
+        if (a.up)
+          {
+            m_edges[fill[a.node]++] = i;
+            m_edges[fill[m_nNodes + a.channel]++] = i;
+          }
+      }
+  }
+
+  bool
+  IsUsed (uint32_t source, uint32_t attachment) const
+  {
+    const std::vector<uint64_t> &used = m_used[source];
+    return attachment / 64 < used.size () && (used[attachment / 64] >> (attachment % 64)) & 1;
+  }
+
+  /**
+   * Dijkstra from source, recording for every vertex reached the interface
+   * and gateway of the first hop towards it.  Stops early once target is
+   * settled (pass INFINITE for a full tree).  Only the vertices listed in
+   * w.touched are valid afterwards.
+   */
+  void
+  Search (uint32_t source, uint32_t target, Workspace &w) const
+  {
+    uint32_t nVertices = m_nNodes + m_nChannels;
+    if (w.dist.size () != nVertices)
+      {
+        w.dist.assign (nVertices, INFINITE);
+        w.via.resize (nVertices);
+        w.hopInterface.resize (nVertices);
+        w.hopGateway.resize (nVertices);
+        w.touched.clear ();
+      }
+    // Undo the previous search instead of clearing everything, so a short
+    // search costs only what it visits.
+    for (std::vector<uint32_t>::const_iterator v = w.touched.begin (); v != w.touched.end (); ++v)
+      {
+        w.dist[*v] = INFINITE;
+      }
+    w.touched.clear ();
+    w.heap.clear ();
+
+    std::greater<std::pair<uint32_t, uint32_t> > later;
+    w.dist[source] = 0;
+    w.touched.push_back (source);
+    w.heap.push_back (std::make_pair (0, source));
+    while (!w.heap.empty ())
+      {
+        std::pop_heap (w.heap.begin (), w.heap.end (), later);
+        uint32_t d = w.heap.back ().first;
+        uint32_t v = w.heap.back ().second;
+        w.heap.pop_back ();
+        if (d > w.dist[v])
+          {
+            continue;
+          }
+        if (v == target)
+          {
+            break;
+          }
+        bool isNode = v < m_nNodes;
+        if (isNode && v != source && !m_attachments[w.via[v]].forwarding)
+          {
+            // Reachable, but does not forward what it receives there
+            continue;
+          }
+        for (uint32_t e = m_start[v]; e < m_start[v + 1]; ++e)
+          {
+            const Attachment &a = m_attachments[m_edges[e]];
+            uint32_t t = isNode ? m_nNodes + a.channel : a.node;
+            uint32_t dt = d + (isNode ? a.metric : 0);
+            if (dt >= w.dist[t])
+              {
+                continue;
+              }
+            if (w.dist[t] == INFINITE)
+              {
+                w.touched.push_back (t);
+              }
+            w.dist[t] = dt;
+            w.via[t] = m_edges[e];
+            if (v == source)
+              {
+                // A channel of the source itself: directly connected
+                w.hopInterface[t] = a.interface;
+                w.hopGateway[t] = 0;
+              }
+            else if (!isNode && w.hopGateway[v] == 0)
+              {
+                // A neighbour of the source: it is the gateway
+                w.hopInterface[t] = w.hopInterface[v];
+                w.hopGateway[t] = a.address;
+              }
+            else
+              {
+                w.hopInterface[t] = w.hopInterface[v];
+                w.hopGateway[t] = w.hopGateway[v];
+              }
+            w.heap.push_back (std::make_pair (dt, t));
+            std::push_heap (w.heap.begin (), w.heap.end (), later);
+          }
+      }
+  }
+
+  /**
+   * The full tree of source, turned into routes for every remote subnet.
+   */
+  void
+  Spf (uint32_t source, Workspace &w, Result &result) const
+  {
+    Search (source, INFINITE, w);
+    result.routes.clear ();
+    result.used.assign ((m_attachments.size () + 63) / 64, 0);
+    for (std::vector<uint32_t>::const_iterator it = w.touched.begin (); it != w.touched.end (); ++it)
+      {
+        uint32_t v = *it;
+        if (v == source)
+          {
+            continue;
+          }
+        result.used[w.via[v] / 64] |= uint64_t (1) << (w.via[v] % 64);
+        if (v < m_nNodes || w.hopGateway[v] == 0)
+          {
+            continue;
+          }
+        uint32_t c = v - m_nNodes;
+        for (uint32_t s = m_subnetStart[c]; s < m_subnetStart[c + 1]; ++s)
+          {
+            Route r;
+            r.network = m_subnets[s].network;
+            r.mask = m_subnets[s].mask;
+            r.gateway = w.hopGateway[v];
+            r.interface = w.hopInterface[v];
+            r.metric = w.dist[v];
+            result.routes.push_back (r);
+          }
+      }
+  }
+
+  void
+  Worker (Batch *batch) const
+  {
+    Workspace w;
+    while (true)
+      {
+        uint32_t i = batch->next++;
+        if (i >= batch->end)
+          {
+            break;
+          }
+        Spf ((*batch->sources)[i], w, batch->results[i - batch->begin]);
+      }
+  }
+
+  /**
+   * Recomputes and reinstalls the routes of sources.  Sources are handled
+   * in slices so that only a slice worth of results is held at once.
+   */
+  void
+  Compute (const std::vector<uint32_t> &sources)
+  {
+    m_lastRecomputed = sources.size ();
+    uint32_t slice = 32 * m_nThreads;
+    for (uint32_t begin = 0; begin < sources.size (); begin += slice)
+      {
+        Batch batch;
+        batch.sources = &sources;
+        batch.begin = begin;
+        batch.end = std::min<uint32_t> (begin + slice, sources.size ());
+        batch.next = begin;
+        batch.results.resize (batch.end - begin);
+
+        uint32_t nThreads = std::min (m_nThreads, batch.end - begin);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 1; t < nThreads; ++t)
+          {
+            threads.push_back (std::thread (&SpfRoutingHelper::Worker, this, &batch));
+          }
+        Worker (&batch);
+        for (uint32_t t = 0; t < threads.size (); ++t)
+          {
+            threads[t].join ();
+          }
+
+        // Routing objects are not thread safe; install from this thread.
+        for (uint32_t i = begin; i < batch.end; ++i)
+          {
+            Result &result = batch.results[i - begin];
+            Install (sources[i], result.routes);
+            m_used[sources[i]].swap (result.used);
+          }
+      }
+  }
+
+  void
+  Install (uint32_t n, const std::vector<Route> &routes)
+  {
+    Ptr<Ipv4> ipv4 = NodeList::GetNode (n)->GetObject<Ipv4> ();
+    Ptr<Ipv4TrieRouting> trie = Ipv4TrieRouting::Get (ipv4);
+    if (trie != 0)
+      {
+        // The trie only holds our routes, so it is simply refilled.
+        trie->Clear ();
+        for (std::vector<Route>::const_iterator r = routes.begin (); r != routes.end (); ++r)
+          {
+            trie->AddNetworkRouteTo (Ipv4Address (r->network), Ipv4Mask (r->mask),
+                                     Ipv4Address (r->gateway), r->interface, r->metric);
+          }
+        return;
+      }
+
+    Ipv4StaticRoutingHelper helper;
+    Ptr<Ipv4StaticRouting> staticRouting = helper.GetStaticRouting (ipv4);
+    NS_ABORT_MSG_IF (staticRouting == 0, "SpfRoutingHelper needs Ipv4StaticRouting on node " << n);
+
+    // Take out what an earlier computation installed.  Interfaces going
+    // down may already have removed some of it.
+    std::set<Route> old (m_installed[n].begin (), m_installed[n].end ());
+    for (uint32_t i = staticRouting->GetNRoutes (); i-- > 0 && !old.empty (); )
+      {
+        Ipv4RoutingTableEntry entry = staticRouting->GetRoute (i);
+        Route r;
+        r.network = entry.GetDest ().Get ();
+        r.mask = entry.GetDestNetworkMask ().Get ();
+        r.gateway = entry.GetGateway ().Get ();
+        r.interface = entry.GetInterface ();
+        if (old.erase (r) != 0)
+          {
+            staticRouting->RemoveRoute (i);
+          }
+      }
+
+    for (std::vector<Route>::const_iterator r = routes.begin (); r != routes.end (); ++r)
+      {
+        staticRouting->AddNetworkRouteTo (Ipv4Address (r->network), Ipv4Mask (r->mask),
+                                          Ipv4Address (r->gateway), r->interface, r->metric);
+      }
+    m_installed[n] = routes;
+  }
+
+  uint32_t m_nThreads;
+  uint32_t m_nNodes;
+  uint32_t m_nChannels;
+  std::vector<bool> m_router;
+  std::vector<Attachment> m_attachments;
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> m_attachmentIndex;
+  std::vector<uint32_t> m_start;
+  std::vector<uint32_t> m_edges;
+  std::vector<uint32_t> m_subnetStart;
+  std::vector<Subnet> m_subnets;
+  // (prefix length, network) to channel, for FindFirstHop
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> m_subnetIndex;
+  std::set<uint32_t> m_prefixLengths;
+  Workspace m_workspace;
+  uint32_t m_generation;
+  // Whether Populate installed routes that changes must update
+  bool m_populated;
+  // Per source node: routes installed and attachments its tree uses
+  std::vector<std::vector<Route> > m_installed;
+  std::vector<std::vector<uint64_t> > m_used;
+  uint32_t m_lastRecomputed;
+};
+
+const uint32_t SpfRoutingHelper::INFINITE;
+
+} // namespace ns3
+
+#endif /* SPF_ROUTING_HELPER_H */
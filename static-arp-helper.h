@@ -0,0 +1,109 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STATIC_ARP_HELPER_H
+#define STATIC_ARP_HELPER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/arp-cache.h"
+#include "ns3/ipv4-interface.h"
+#include "ns3/ipv4-l3-protocol.h"
+
+namespace ns3 {
+
+/**
+ * Fills ARP caches from address assignments so that no ARP request is
+ * ever sent: every interface learns the MAC address of the others on its
+ * channel, as permanent entries that never expire.  Links without ARP
+ * (point to point) are skipped.
+ *
+ * Call after Ipv4AddressHelper::Assign.  An interface going down flushes
+ * its cache, after which ARP resolves addresses again as usual.
+ */
+class StaticArpHelper
+{
+public:
+  /**
+   * Every interface of interfaces learns every other one on its channel.
+   * This costs the square of the bus size in entries; for large buses,
+   * restrict the entries with the other overload.
+   *
+   * \returns the number of entries written
+   */
+  static uint32_t
+  Populate (const Ipv4InterfaceContainer &interfaces)
+  {
+    return Populate (interfaces, interfaces);
+  }
+
+  /**
+   * Every interface of interfaces learns the addresses of those of
+   * targets on its channel, e.g. a server and its default gateway.
+   *
+   * \returns the number of entries written
+   */
+  static uint32_t
+  Populate (const Ipv4InterfaceContainer &interfaces, const Ipv4InterfaceContainer &targets)
+  {
+    uint32_t entries = 0;
+    for (uint32_t t = 0; t < targets.GetN (); ++t)
+      {
+        Ptr<Ipv4Interface> target = GetInterface (targets.Get (t));
+        Ptr<NetDevice> device = target->GetDevice ();
+        if (!device->NeedsArp ())
+          {
+            continue;
+          }
+        for (uint32_t i = 0; i < interfaces.GetN (); ++i)
+          {
+            Ptr<Ipv4Interface> learner = GetInterface (interfaces.Get (i));
+            if (learner == target || learner->GetDevice ()->GetChannel () != device->GetChannel ()
+                || learner->GetArpCache () == 0)
+              {
+                continue;
+              }
+            for (uint32_t a = 0; a < target->GetNAddresses (); ++a)
+              {
+                Ipv4Address address = target->GetAddress (a).GetLocal ();
+                ArpCache::Entry *entry = learner->GetArpCache ()->Lookup (address);
+                if (entry == 0)
+                  {
+                    entry = learner->GetArpCache ()->Add (address);
+                  }
+                entry->SetMacAddress (device->GetAddress ());
+                entry->MarkPermanent ();
+                ++entries;
+              }
+          }
+      }
+    return entries;
+  }
+
+private:
+  static Ptr<Ipv4Interface>
+  GetInterface (std::pair<Ptr<Ipv4>, uint32_t> assignment)
+  {
+    Ptr<Ipv4L3Protocol> ipv4 = assignment.first->GetObject<Ipv4L3Protocol> ();
+    NS_ABORT_MSG_IF (ipv4 == 0, "StaticArpHelper needs Ipv4L3Protocol");
+    return ipv4->GetInterface (assignment.second);
+  }
+};
+
+} // namespace ns3
+
+#endif /* STATIC_ARP_HELPER_H */
@@ -0,0 +1,239 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STATION_ECHO_SWEEP_H
+#define STATION_ECHO_SWEEP_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+
+#include "fork-sweep.h"
+#include "udp-echo-rtt-client.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * The echo traffic of FinalProject.cc and lab5.cc, where an AP is
+ * surrounded by stations A to D, 115 m away along the axes, and two of
+ * them send echoes to two others, on ports 9 and 19, one after the other.
+ *
+ * The clients are only added by InstallClients, so that a sweep can fork
+ * the built scenario once the stations have associated and add them in
+ * each child.  The swept parameter is "distance", which moves A to D to
+ * that distance from the AP along their axes, "packetSize", or
+ * "startTime", which moves both client windows so that the first one
+ * starts then.  Each child reports the echo replies that made it back.
+ */
+class StationEchoSweep
+{
+public:
+  /**
+   * \param maxPackets echoes sent by each client
+   */
+  StationEchoSweep (uint32_t maxPackets)
+    : m_maxPackets (maxPackets),
+      m_rtt (false),
+      m_replies (0)
+  {
+  }
+
+  /**
+   * \param stations A, B, C and D, in this order
+   */
+  void
+  SetStations (NodeContainer stations)
+  {
+    m_stations = stations;
+  }
+
+  void
+  SetClients (Ptr<Node> client, Ipv4Address server, Ptr<Node> client2, Ipv4Address server2)
+  {
+    m_client = client;
+    m_server = server;
+    m_client2 = client2;
+    m_server2 = server2;
+  }
+
+  /**
+   * Whether the clients are UdpEchoRttClients rather than UdpEchoClients.
+   */
+  void
+  SetRtt (bool rtt)
+  {
+    m_rtt = rtt;
+  }
+
+  /**
+   * Counts the echo replies delivered on any node from now on.
+   */
+  void
+  CountReplies (void)
+  {
+    Config::ConnectWithoutContext ("/NodeList/*/$ns3::Ipv4L3Protocol/LocalDeliver",
+                                   MakeCallback (&StationEchoSweep::ReplyDelivered, this));
+  }
+
+  /**
+   * Adds the clients, with their windows moved by offset.  Times are
+   * relative to the current simulation time, as for any application added
+   * to a node once the simulation is running.
+   */
+  void
+  InstallClients (uint32_t packetSize, Time offset)
+  {
+    UdpEchoRttClientHelper echoClient (m_server, 9, m_rtt);
+    echoClient.SetAttribute ("MaxPackets", UintegerValue (m_maxPackets));
+    echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
+    echoClient.SetAttribute ("PacketSize", UintegerValue (packetSize));
+
+    UdpEchoRttClientHelper echoClient2 (m_server2, 19, m_rtt);
+    echoClient2.SetAttribute ("MaxPackets", UintegerValue (m_maxPackets));
+    echoClient2.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
+    echoClient2.SetAttribute ("PacketSize", UintegerValue (packetSize));
+
+    Time now = Simulator::Now ();
+
+    ApplicationContainer clientApps = echoClient.Install (m_client);
+    clientApps.Start (Seconds (2.0) + offset - now);
+    clientApps.Stop (Seconds (6.0) + offset - now);
+
+    ApplicationContainer clientApps2 = echoClient2.Install (m_client2);
+    clientApps2.Start (Seconds (12.0) + offset - now);
+    clientApps2.Stop (Seconds (15.0) + offset - now);
+  }
+
+  /**
+   * \returns value as a UDP payload size; aborts unless it is a whole
+   * number from 0 to 65507
+   */
+  static uint32_t
+  ToPacketSize (double value)
+  {
+    NS_ABORT_MSG_IF (!(value >= 0 && value <= 65507) || value != static_cast<uint32_t> (value),
+                     "Packet size " << value << " is not a UDP payload size");
+    return static_cast<uint32_t> (value);
+  }
+
+  /**
+   * Runs the built scenario up to forkAt, by which time the stations have
+   * heard the first beacon and associated, then forks one child per value
+   * and prints the replies each of them got.
+   */
+  void
+  Run (std::string parameter, std::vector<double> values, double forkAt, uint32_t nJobs)
+  {
+    NS_ABORT_MSG_UNLESS (parameter == "distance" || parameter == "packetSize" || parameter == "startTime",
+                         "Unknown sweep parameter \"" << parameter << "\"");
+    m_parameter = parameter;
+    m_values = values;
+    if (parameter == "packetSize")
+      {
+        // Before forking, so that a bad value is not just a failed child
+        for (uint32_t i = 0; i < values.size (); ++i)
+          {
+            ToPacketSize (values[i]);
+          }
+      }
+    Simulator::Stop (Seconds (forkAt));
+    Simulator::Run ();
+
+    std::vector<uint32_t> replies = ForkSweep (nJobs).Run (m_values.size (),
+                                                           MakeCallback (&StationEchoSweep::RunJob, this));
+    std::cout << m_parameter << "\treplies" << std::endl;
+    for (uint32_t i = 0; i < replies.size (); ++i)
+      {
+        std::cout << m_values[i] << "\t";
+        if (replies[i] == ForkSweep::FAILED)
+          {
+            std::cout << "failed" << std::endl;
+          }
+        else
+          {
+            std::cout << replies[i] << std::endl;
+          }
+      }
+  }
+
+private:
+  void
+  ReplyDelivered (const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface)
+  {
+    if (header.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+      {
+        return;
+      }
+    UdpHeader udpHeader;
+    packet->PeekHeader (udpHeader);
+    if (udpHeader.GetSourcePort () == 9 || udpHeader.GetSourcePort () == 19)
+      {
+        ++m_replies;
+      }
+  }
+
+  // Runs in a child forked from the warmed up scenario: applies one value
+  // of the swept parameter, adds the clients and finishes the run.
+  uint32_t
+  RunJob (uint32_t index)
+  {
+    double value = m_values[index];
+    uint32_t packetSize = 1024;
+    Time offset = Seconds (0.0);
+    if (m_parameter == "distance")
+      {
+        m_stations.Get (0)->GetObject<MobilityModel> ()->SetPosition (Vector (0.0, value, 0.0));
+        m_stations.Get (1)->GetObject<MobilityModel> ()->SetPosition (Vector (value, 0.0, 0.0));
+        m_stations.Get (2)->GetObject<MobilityModel> ()->SetPosition (Vector (0.0, -value, 0.0));
+        m_stations.Get (3)->GetObject<MobilityModel> ()->SetPosition (Vector (-value, 0.0, 0.0));
+      }
+    else if (m_parameter == "packetSize")
+      {
+        packetSize = ToPacketSize (value);
+      }
+    else
+      {
+        offset = Seconds (value) - Seconds (2.0);
+        NS_ABORT_MSG_IF (Seconds (value) < Simulator::Now (),
+                         "Client start time " << value << " s is before the snapshot");
+      }
+
+    InstallClients (packetSize, offset);
+    Simulator::Run ();
+    return m_replies;
+  }
+
+  uint32_t m_maxPackets;
+  bool m_rtt;
+  NodeContainer m_stations;
+  Ptr<Node> m_client;
+  Ptr<Node> m_client2;
+  Ipv4Address m_server;
+  Ipv4Address m_server2;
+  // Echo replies that made it back to the clients in the current run
+  uint32_t m_replies;
+  std::string m_parameter;
+  std::vector<double> m_values;
+};
+
+} // namespace ns3
+
+#endif /* STATION_ECHO_SWEEP_H */
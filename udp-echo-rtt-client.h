@@ -0,0 +1,481 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef UDP_ECHO_RTT_CLIENT_H
+#define UDP_ECHO_RTT_CLIENT_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/seq-ts-header.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * Histogram of durations in nanoseconds with log-spaced buckets, in the
+ * manner of HdrHistogram: values below 64 have a bucket each, and every
+ * power of two above that is split into 32 buckets, so a percentile is
+ * within 1/32 of the recorded value whatever its magnitude.  The whole
+ * uint64_t range fits in a fixed 1920 buckets, about 7.5 KiB.
+ */
+class RttHistogram
+{
+public:
+  RttHistogram ()
+    : m_count (0),
+      m_min (~uint64_t (0)),
+      m_max (0),
+      m_sum (0)
+  {
+    std::fill (m_buckets, m_buckets + BUCKETS, 0);
+  }
+
+  void
+  Record (uint64_t value)
+  {
+    ++m_buckets[GetIndex (value)];
+    ++m_count;
+    m_min = std::min (m_min, value);
+    m_max = std::max (m_max, value);
+    m_sum += value;
+  }
+
+  uint64_t
+  GetCount (void) const
+  {
+    return m_count;
+  }
+
+  uint64_t
+  GetMin (void) const
+  {
+    return m_count == 0 ? 0 : m_min;
+  }
+
+  uint64_t
+  GetMax (void) const
+  {
+    return m_max;
+  }
+
+  double
+  GetMean (void) const
+  {
+    return m_count == 0 ? 0 : double (m_sum) / m_count;
+  }
+
+  /**
+   * The smallest value at or below which a fraction q of the recorded
+   * values lie, rounded up to the top of its bucket but never past the
+   * largest value recorded; 0 when nothing was recorded.
+   */
+  uint64_t
+  GetPercentile (double q) const
+  {
+    if (m_count == 0)
+      {
+        return 0;
+      }
+    uint64_t rank = std::max<uint64_t> (1, std::ceil (q * m_count));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKETS; ++i)
+      {
+        seen += m_buckets[i];
+        if (seen >= rank)
+          {
+            return std::min (GetHighest (i), m_max);
+          }
+      }
+    return m_max;
+  }
+
+private:
+  static const uint32_t SUB_BUCKETS = 64;
+  static const uint32_t BUCKETS = SUB_BUCKETS + 58 * SUB_BUCKETS / 2;
+
+  static uint32_t
+  GetIndex (uint64_t value)
+  {
+    if (value < SUB_BUCKETS)
+      {
+        return value;
+      }
+    // Shift that leaves the value in [32, 64)
+    uint32_t shift = 63 - __builtin_clzll (value) - 5;
+    return SUB_BUCKETS + (shift - 1) * SUB_BUCKETS / 2 + ((value >> shift) - SUB_BUCKETS / 2);
+  }
+
+  static uint64_t
+  GetHighest (uint32_t index)
+  {
+    if (index < SUB_BUCKETS)
+      {
+        return index;
+      }
+    uint32_t shift = (index - SUB_BUCKETS) / (SUB_BUCKETS / 2) + 1;
+    uint64_t sub = (index - SUB_BUCKETS) % (SUB_BUCKETS / 2) + SUB_BUCKETS / 2;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  uint32_t m_buckets[BUCKETS];
+  uint64_t m_count;
+  uint64_t m_min;
+  uint64_t m_max;
+  uint64_t m_sum;
+};
+
+/**
+ * UDP echo client that measures round trips instead of logging them.
+ *
+ * It sends like UdpEchoClient and has the same attributes, but starts
+ * each packet with a SeqTsHeader, which UdpEchoServer sends back as it
+ * is.  The round trip of each echo goes into an RttHistogram and out
+ * through the Rtt trace source; the RttP50, RttP99 and RttP999 and
+ * LostPackets attributes read the results, which Print sums up.  Packets
+ * still in flight when the client stops count as lost.  PacketSize is the
+ * payload size, header included, and at least the 12 bytes of the header.
+ *
+ * For high rates, Burst packets are sent back to back by each send event,
+ * every Interval.  The payload is the zero-filled area of the buffer,
+ * which takes no memory, and the buffer itself comes from the free list
+ * the Buffer class keeps.
+ */
+class UdpEchoRttClient : public Application
+{
+public:
+  typedef void (*RttTracedCallback) (Time rtt);
+
+  static TypeId
+  GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::UdpEchoRttClient")
+      .SetParent<Application> ()
+      .AddConstructor<UdpEchoRttClient> ()
+      .AddAttribute ("MaxPackets",
+                     "The maximum number of packets the application will send",
+                     UintegerValue (100),
+                     MakeUintegerAccessor (&UdpEchoRttClient::m_count),
+                     MakeUintegerChecker<uint32_t> ())
+      .AddAttribute ("Interval",
+                     "The time to wait between packets",
+                     TimeValue (Seconds (1.0)),
+                     MakeTimeAccessor (&UdpEchoRttClient::m_interval),
+                     MakeTimeChecker ())
+      .AddAttribute ("RemoteAddress",
+                     "The destination Address of the outbound packets",
+                     AddressValue (),
+                     MakeAddressAccessor (&UdpEchoRttClient::m_peerAddress),
+                     MakeAddressChecker ())
+      .AddAttribute ("RemotePort",
+                     "The destination port of the outbound packets",
+                     UintegerValue (0),
+                     MakeUintegerAccessor (&UdpEchoRttClient::m_peerPort),
+                     MakeUintegerChecker<uint16_t> ())
+      .AddAttribute ("PacketSize", "Size of echo data in outbound packets",
+                     UintegerValue (100),
+                     MakeUintegerAccessor (&UdpEchoRttClient::m_size),
+                     MakeUintegerChecker<uint32_t> ())
+      .AddAttribute ("Burst", "Packets sent back to back every Interval",
+                     UintegerValue (1),
+                     MakeUintegerAccessor (&UdpEchoRttClient::m_burst),
+                     MakeUintegerChecker<uint32_t> (1))
+      .AddAttribute ("RttP50", "Median round trip time so far",
+                     TypeId::ATTR_GET,
+                     TimeValue (),
+                     MakeTimeAccessor (&UdpEchoRttClient::GetRttP50),
+                     MakeTimeChecker ())
+      .AddAttribute ("RttP99", "99th percentile round trip time so far",
+                     TypeId::ATTR_GET,
+                     TimeValue (),
+                     MakeTimeAccessor (&UdpEchoRttClient::GetRttP99),
+                     MakeTimeChecker ())
+      .AddAttribute ("RttP999", "99.9th percentile round trip time so far",
+                     TypeId::ATTR_GET,
+                     TimeValue (),
+                     MakeTimeAccessor (&UdpEchoRttClient::GetRttP999),
+                     MakeTimeChecker ())
+      .AddAttribute ("LostPackets", "Packets sent and not echoed back (yet)",
+                     TypeId::ATTR_GET,
+                     UintegerValue (0),
+                     MakeUintegerAccessor (&UdpEchoRttClient::GetLostPackets),
+                     MakeUintegerChecker<uint32_t> ())
+      .AddTraceSource ("Tx", "A new packet is created and is sent",
+                       MakeTraceSourceAccessor (&UdpEchoRttClient::m_txTrace),
+                       "ns3::Packet::TracedCallback")
+      .AddTraceSource ("Rx", "An echo is received",
+                       MakeTraceSourceAccessor (&UdpEchoRttClient::m_rxTrace),
+                       "ns3::Packet::TracedCallback")
+      .AddTraceSource ("Rtt", "Round trip time of an echo",
+                       MakeTraceSourceAccessor (&UdpEchoRttClient::m_rttTrace),
+                       "ns3::UdpEchoRttClient::RttTracedCallback")
+    ;
+    return tid;
+  }
+
+  UdpEchoRttClient ()
+    : m_sent (0),
+      m_received (0)
+  {
+  }
+
+  Time
+  GetRttPercentile (double q) const
+  {
+    return NanoSeconds (m_rtt.GetPercentile (q));
+  }
+
+  Time
+  GetRttP50 (void) const
+  {
+    return GetRttPercentile (0.5);
+  }
+
+  Time
+  GetRttP99 (void) const
+  {
+    return GetRttPercentile (0.99);
+  }
+
+  Time
+  GetRttP999 (void) const
+  {
+    return GetRttPercentile (0.999);
+  }
+
+  uint32_t
+  GetLostPackets (void) const
+  {
+    return m_sent - std::min (m_received, m_sent);
+  }
+
+  const RttHistogram &
+  GetHistogram (void) const
+  {
+    return m_rtt;
+  }
+
+  /**
+   * One line: node, server, packets sent, echoed and lost, and the round
+   * trip percentiles in milliseconds.
+   */
+  void
+  Print (std::ostream &os) const
+  {
+    os << "Node " << GetNode ()->GetId () << " echo client to ";
+    if (Ipv4Address::IsMatchingType (m_peerAddress))
+      {
+        os << Ipv4Address::ConvertFrom (m_peerAddress);
+      }
+    else
+      {
+        os << Ipv6Address::ConvertFrom (m_peerAddress);
+      }
+    os << ":" << m_peerPort << ": sent " << m_sent << ", echoed " << m_received
+       << ", lost " << GetLostPackets () << std::fixed << std::setprecision (3)
+       << ", rtt ms min " << m_rtt.GetMin () * 1e-6
+       << " p50 " << GetRttP50 ().GetSeconds () * 1e3
+       << " p99 " << GetRttP99 ().GetSeconds () * 1e3
+       << " p999 " << GetRttP999 ().GetSeconds () * 1e3
+       << " max " << m_rtt.GetMax () * 1e-6 << std::endl;
+  }
+
+protected:
+  virtual void
+  DoDispose (void)
+  {
+    m_socket = 0;
+    Application::DoDispose ();
+  }
+
+private:
+  virtual void
+  StartApplication (void)
+  {
+    if (m_socket == 0)
+      {
+        m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+        if (Ipv4Address::IsMatchingType (m_peerAddress))
+          {
+            m_socket->Bind ();
+            m_socket->Connect (InetSocketAddress (Ipv4Address::ConvertFrom (m_peerAddress), m_peerPort));
+          }
+        else
+          {
+            m_socket->Bind6 ();
+            m_socket->Connect (Inet6SocketAddress (Ipv6Address::ConvertFrom (m_peerAddress), m_peerPort));
+          }
+      }
+    m_socket->SetRecvCallback (MakeCallback (&UdpEchoRttClient::HandleRead, this));
+    ScheduleTransmit (Seconds (0.));
+  }
+
+  virtual void
+  StopApplication (void)
+  {
+    if (m_socket != 0)
+      {
+        m_socket->Close ();
+        m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+        m_socket = 0;
+      }
+    Simulator::Cancel (m_sendEvent);
+  }
+
+  void
+  ScheduleTransmit (Time dt)
+  {
+    m_sendEvent = Simulator::Schedule (dt, &UdpEchoRttClient::Send, this);
+  }
+
+  void
+  Send (void)
+  {
+    for (uint32_t i = 0; i < m_burst; ++i)
+      {
+        SeqTsHeader header;
+        header.SetSeq (m_sent);
+        uint32_t headerSize = header.GetSerializedSize ();
+        Ptr<Packet> p = Create<Packet> (m_size > headerSize ? m_size - headerSize : 0);
+        p->AddHeader (header);
+        m_txTrace (p);
+        m_socket->Send (p);
+        ++m_sent;
+        if (m_sent >= m_count)
+          {
+            return;
+          }
+      }
+    ScheduleTransmit (m_interval);
+  }
+
+  void
+  HandleRead (Ptr<Socket> socket)
+  {
+    Ptr<Packet> packet;
+    Address from;
+    while ((packet = socket->RecvFrom (from)))
+      {
+        m_rxTrace (packet);
+        SeqTsHeader header;
+        if (packet->GetSize () < header.GetSerializedSize ())
+          {
+            continue;
+          }
+        packet->RemoveHeader (header);
+        Time rtt = Simulator::Now () - header.GetTs ();
+        m_rtt.Record (rtt.GetNanoSeconds ());
+        ++m_received;
+        m_rttTrace (rtt);
+      }
+  }
+
+  uint32_t m_count;
+  Time m_interval;
+  uint32_t m_size;
+  Address m_peerAddress;
+  uint16_t m_peerPort;
+  uint32_t m_sent;
+  uint32_t m_received;
+  uint32_t m_burst;
+  Ptr<Socket> m_socket;
+  EventId m_sendEvent;
+  RttHistogram m_rtt;
+  TracedCallback<Ptr<const Packet> > m_txTrace;
+  TracedCallback<Ptr<const Packet> > m_rxTrace;
+  TracedCallback<Time> m_rttTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (UdpEchoRttClient);
+
+/**
+ * UdpEchoClientHelper for either client: a UdpEchoRttClient when rtt is
+ * true, otherwise the stock UdpEchoClient with its per-packet logging.
+ * Both take the same attributes.
+ */
+class UdpEchoRttClientHelper
+{
+public:
+  UdpEchoRttClientHelper (Address address, uint16_t port, bool rtt = true)
+  {
+    m_factory.SetTypeId (rtt ? UdpEchoRttClient::GetTypeId () : UdpEchoClient::GetTypeId ());
+    m_factory.Set ("RemoteAddress", AddressValue (address));
+    m_factory.Set ("RemotePort", UintegerValue (port));
+  }
+
+  void
+  SetAttribute (std::string name, const AttributeValue &value)
+  {
+    m_factory.Set (name, value);
+  }
+
+  ApplicationContainer
+  Install (Ptr<Node> node) const
+  {
+    return ApplicationContainer (InstallPriv (node));
+  }
+
+  ApplicationContainer
+  Install (NodeContainer c) const
+  {
+    ApplicationContainer apps;
+    for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+      {
+        apps.Add (InstallPriv (*i));
+      }
+    return apps;
+  }
+
+  /**
+   * Prints the summary of every UdpEchoRttClient of the simulation.
+   */
+  static void
+  PrintAll (std::ostream &os)
+  {
+    for (NodeList::Iterator n = NodeList::Begin (); n != NodeList::End (); ++n)
+      {
+        for (uint32_t a = 0; a < (*n)->GetNApplications (); ++a)
+          {
+            Ptr<UdpEchoRttClient> client = DynamicCast<UdpEchoRttClient> ((*n)->GetApplication (a));
+            if (client != 0)
+              {
+                client->Print (os);
+              }
+          }
+      }
+  }
+
+private:
+  Ptr<Application>
+  InstallPriv (Ptr<Node> node) const
+  {
+    Ptr<Application> app = m_factory.Create<Application> ();
+    node->AddApplication (app);
+    return app;
+  }
+
+  ObjectFactory m_factory;
+};
+
+} // namespace ns3
+
+#endif /* UDP_ECHO_RTT_CLIENT_H */
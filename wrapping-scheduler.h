@@ -0,0 +1,130 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef WRAPPING_SCHEDULER_H
+#define WRAPPING_SCHEDULER_H
+
+#include "ns3/core-module.h"
+#include "ns3/scheduler.h"
+
+#include <string>
+
+namespace ns3 {
+
+/**
+ * Base of the schedulers that pass every operation on to another one, the
+ * one the simulation would otherwise use, and watch what goes through.
+ *
+ * A derived class adds the Inner attribute to its own TypeId with
+ * AddInnerAttribute, since attribute defaults are kept per TypeId and the
+ * wrappers can be stacked, and goes in front of the scheduler selected so
+ * far with Wrap.  The inner scheduler is created when the first event is
+ * inserted, at which point DoStart is called.
+ */
+class WrappingScheduler : public Scheduler
+{
+public:
+  virtual void
+  Insert (const Event &ev)
+  {
+    GetInner ()->Insert (ev);
+  }
+
+  virtual bool
+  IsEmpty (void) const
+  {
+    return m_inner == 0 || m_inner->IsEmpty ();
+  }
+
+  virtual Event
+  PeekNext (void) const
+  {
+    return m_inner->PeekNext ();
+  }
+
+  virtual Event
+  RemoveNext (void)
+  {
+    return m_inner->RemoveNext ();
+  }
+
+  virtual void
+  Remove (const Event &ev)
+  {
+    m_inner->Remove (ev);
+  }
+
+protected:
+  static TypeId
+  AddInnerAttribute (TypeId tid)
+  {
+    return tid.AddAttribute ("Inner",
+                             "Scheduler actually holding the events.",
+                             TypeIdValue (MapScheduler::GetTypeId ()),
+                             MakeTypeIdAccessor (&WrappingScheduler::m_innerType),
+                             MakeTypeIdChecker ());
+  }
+
+  /**
+   * Makes tid the SchedulerType, holding its events in the scheduler
+   * selected so far.  Call before anything is scheduled.
+   *
+   * \returns false if tid already was the SchedulerType
+   */
+  static bool
+  Wrap (TypeId tid)
+  {
+    TypeIdValue current;
+    GlobalValue::GetValueByName ("SchedulerType", current);
+    if (current.Get () == tid)
+      {
+        return false;
+      }
+    Config::SetDefault (tid.GetName () + "::Inner", current);
+    GlobalValue::Bind ("SchedulerType", TypeIdValue (tid));
+    return true;
+  }
+
+  Ptr<Scheduler>
+  GetInner (void)
+  {
+    if (m_inner == 0)
+      {
+        // Attributes are only set once the constructor has returned.
+        ObjectFactory factory;
+        factory.SetTypeId (m_innerType);
+        m_inner = factory.Create<Scheduler> ();
+        DoStart ();
+      }
+    return m_inner;
+  }
+
+  /**
+   * Called once, as the first event is inserted.
+   */
+  virtual void
+  DoStart (void)
+  {
+  }
+
+private:
+  TypeId m_innerType;
+  Ptr<Scheduler> m_inner;
+};
+
+} // namespace ns3
+
+#endif /* WRAPPING_SCHEDULER_H */